@@ -4,6 +4,7 @@
 #include <array>
 
 #include "devices/distance_sensor.h"
+#include "os/compare_match_lane-global.h"
 #include "os/scheduler-global.h"
 
 #include "Arduino.h"
@@ -51,6 +52,7 @@ int main() {
   // Init Arduino IDE libraries.
   init();  // wiring.c
   Serial.begin(9600);
+  compare_match_lane.Start();  // After init(), which configures Timer1.
 
   Robot robot;
   robot.Run();
@@ -0,0 +1,50 @@
+#!/bin/bash
+#
+# Builds and runs benchmarks of source code in development environment
+# - *not* in the AVR microcontroller.
+
+set -eumo pipefail
+
+source $(dirname $0)/config.sh
+source build/compile.sh
+source build/util.sh
+
+
+# Builds and runs benchmarks in development environment.
+#
+# @param $1..$n Paths to .cc source files with benchmark programs.
+#   If no paths are given, runs all benchmarks found in the repository.
+function main() {
+  if [[ $@ ]]; then
+    local -a benchmarks=( $@ )
+  else
+    local -a benchmarks=(
+      $(find -name third_party -prune -o -name '*benchmark.cc' -print | cut -c3-)
+    )
+  fi
+  build_run_benchmarks ${benchmarks[@]}
+}
+
+function build_run_benchmarks() {
+  local -a benchmarks=($@)
+  for benchmark_src in ${benchmarks[@]}; do
+    echo $benchmark_src >&2  # Keeps stdout machine-readable.
+
+    # Build the benchmark. Optimized, without debug logging and checks.
+    benchmark_bin="out/$(strip_extension $benchmark_src)"
+    mkdir -p $(dirname $benchmark_bin)
+    # TODO: Generalize and reuse compile().
+    g++  \
+      -std=c++17 -Wall -O2 -DNDEBUG  \
+      $(prepend_each "-I" ${INCLUDE_DIRS[@]})  \
+      $benchmark_src -o $benchmark_bin
+
+    # Run the benchmark.
+    $benchmark_bin
+  done
+}
+
+
+if [[ $0 == ${BASH_SOURCE[0]} ]]; then  # Executed directly, not sourced.
+  main $@
+fi
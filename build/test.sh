@@ -34,8 +34,14 @@ function build_run_tests() {
     test_bin="out/$(strip_extension $test_src)"
     mkdir -p $(dirname $test_bin)
     # TODO: Generalize and reuse compile().
+    # C++17, as the AVR build, but C++20 for tests of coroutines
+    # (see lib/coroutine.h).
+    local std=c++17
+    if grep -q '#include .*coroutine' $test_src; then
+      std=c++20
+    fi
     g++  \
-      -std=c++17 -Wall -O0 -g  \
+      -std=$std -Wall -O0 -g  \
       $(prepend_each "-I" ${INCLUDE_DIRS[@]})  \
       $test_src -o $test_bin
 
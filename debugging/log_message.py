@@ -2,6 +2,10 @@
 import struct
 
 
+# Usec per timer tick on the board (see os/ticks.h).
+MICROS_PER_TICK = 4
+
+
 def PrintBinaryLogMessages(log):
   while True:
     print LogMessage.FromBinary(log).ToLogLine()
@@ -13,7 +17,7 @@ class LogMessage(object):
   def FromBinary(cls, log):
     message_size, = struct.unpack('H', log.read(2))
     binary = log.read(message_size)
-    micros, = struct.unpack_from('I', binary)
+    ticks, = struct.unpack_from('I', binary)
     file_name, _ = cls._UnpackString(binary, 4)
     line_number, severity_binary, num_args = (
       struct.unpack_from('HBB', binary, 4 + 1 + len(file_name)))
@@ -26,7 +30,7 @@ class LogMessage(object):
       offset += arg_size
 
     severity = cls._SEVERITY[severity_binary]
-    return cls(severity, micros, file_name, line_number, args)
+    return cls(severity, ticks * MICROS_PER_TICK, file_name, line_number, args)
 
   def __init__(self, severity, micros, file_name, line_number, args):
     self.severity = severity
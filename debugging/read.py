@@ -13,6 +13,10 @@ import sys
 import serial
 
 
+# Usec per timer tick on the board (see os/ticks.h).
+MICROS_PER_TICK = 4
+
+
 def main(argv):
   if len(argv) >= 2:
     read_func = _READ_FUNCS[argv[1]]
@@ -110,7 +114,7 @@ class Message(object):
   def FromBinary(cls, source):
     message_size, = struct.unpack('H', source.read(2))
     binary = source.read(message_size)
-    micros, = struct.unpack_from('I', binary)
+    ticks, = struct.unpack_from('I', binary)
     file_name, _ = cls._UnpackString(binary, 4)
     line_number, severity_binary, num_args = (
       struct.unpack_from('HBB', binary, 4 + 1 + len(file_name)))
@@ -123,7 +127,7 @@ class Message(object):
       offset += arg_size
 
     severity = cls._SEVERITY[severity_binary]
-    return cls(severity, micros, file_name, line_number, args)
+    return cls(severity, ticks * MICROS_PER_TICK, file_name, line_number, args)
 
   def __init__(self, severity, micros, file_name, line_number, args):
     self.severity = severity
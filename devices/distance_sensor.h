@@ -6,6 +6,7 @@
 
 #include "lib/promise.h"
 #include "lib/stream.h"
+#include "os/compare_match_lane-global.h"
 #include "os/pin.h"
 #include "os/scheduler.h"
 
@@ -32,15 +33,17 @@ public:
   Stream<Reading> StreamDistanceReadings() {
     Stream<Reading> readings;
     trig_pin_.SetState(PinState::LOW);
-    scheduler.RunAfterMicros(2, [this, readings]() mutable {
-      ReadDistances(std::move(readings));
-    });
+    const auto task_id = scheduler.RunAfterMicros(
+      2, [this, readings]() mutable { ReadDistances(std::move(readings)); });
+    if (task_id == scheduler.NO_TASK) {  // Dropped: starts right away.
+      ReadDistances(readings);
+    }
     return readings;
   }
 
 private:
   void ReadDistances(Stream<Reading> readings) {
-    ReadDistance().Then<void>(
+    ReadDistance().ThenVoid(
       [this, readings = std::move(readings)](const Reading& reading) mutable {
         readings.Put(reading);
         ReadDistances(std::move(readings));
@@ -50,10 +53,13 @@ private:
   Promise<Reading> ReadDistance() {
     // TODO: assert echo pin low.
     trig_pin_.SetState(PinState::HIGH);
-    return scheduler.AfterMicros(10).Then<Reading>([this]() {
-      trig_pin_.SetState(PinState::LOW);
-      const uint32_t time_usec = timer.Now();
-      return echo_pin_.OnceSpikes<POLL_FREQUENCY_USEC>().Then<Reading>(
+    // The trigger pulse is ended from the compare-match interrupt handler:
+    // 10 usec wide however busy the scheduler is.
+    Promise<void> pulse_ended = compare_match_lane.RunAfterMicros(
+      10, [this]() { trig_pin_.SetState(PinState::LOW); });
+    return pulse_ended.Then([this]() {
+      const uint32_t time_usec = timer.Now().ToMicros();
+      return echo_pin_.OnceSpikes<POLL_FREQUENCY_USEC>().Then(
         [time_usec](uint32_t echo_pin_spike_duration_usec) {
           const uint16_t distance_mm =
             echo_pin_spike_duration_usec * DISTANCE_MM_PER_MEASUREMENT_USEC;
@@ -43,7 +43,7 @@ public:
   }
 
   static void SetDigitalPinState(uint8_t pin, PinState state) {
-    FakePin::Call call{timer_.Now(), state};
+    FakePin::Call call{timer_.Now().ticks(), state};
     pins_[pin].calls.calls_.push_back(call);
   }
 
@@ -60,7 +60,17 @@ map<int, FakePin> FakeArduino::pins_;
 #define TEST_ARDUINO FakeArduino  // Inject FakeArduino into code under test.
 
 
+#include "os/testing/fake_compare_timer.h"
 #include "os/testing/test_scheduler.h"
+#include "lib/promise.h"
+
+// Each of the 3 sensors polling its echo pin holds 4 of them.
+template <> inline constexpr uint8_t promise_pool_capacity<uint32_t> = 12;
+#include "os/compare_match_lane.h"
+
+volatile CompareMatchLane compare_match_lane_;
+#define TEST_COMPARE_MATCH_LANE compare_match_lane_  // Inject into code under test.
+
 #include "devices/distance_sensor.h"
 #include "lib/testing/streams.h"
 #include "os/pin.h"
@@ -68,6 +78,20 @@ map<int, FakePin> FakeArduino::pins_;
 
 int main() {
   {
+    // The compare timer is kept up with the fake timer, at each of its 4 usec
+    // ticks, before other tasks: the trigger pulse is ended from its interrupt
+    // handler.
+    const auto drive = scheduler.RunEveryMicros(4, []() {
+      const uint16_t now =
+        timer_.Now().ToMicros() * FakeCompareTimer::TICKS_PER_MICRO;
+      compare_timer_.Advance(
+        static_cast<uint16_t>(now - compare_timer_.NowTicks()), []() {
+          Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+          compare_match_lane_.HandleCompareMatch();
+        });
+    });
+    scheduler.SetPriority(drive, TaskPriority::TIME_CRITICAL);
+
     DistanceSensor sensor1("sensor-1", OutputPin(1), InputPin(2));
     FakePin& sensor1_trig_pin = FakeArduino::pin(1);
     FakePin& sensor1_echo_pin = FakeArduino::pin(2);
@@ -52,7 +52,7 @@ struct BinaryFormat {
   static void WriteToStream(const Message<Ts...>& message) {
     WriteBinaryToStream<StreamT, uint16_t>(MessageBinarySize(message));
 
-    WriteBinaryToStream<StreamT>(message.header.micros);
+    WriteBinaryToStream<StreamT>(message.header.ticks);
     WriteBinaryToStream<StreamT>(message.header.file_name);
     WriteBinaryToStream<StreamT>(message.header.line_number);
     WriteBinaryToStream<StreamT>(message.header.severity);
@@ -71,7 +71,7 @@ struct BinaryFormat {
 template <typename... Ts>
 size_t MessageBinarySize(const Message<Ts...>& message) {
   const size_t header_size = 
-    BinarySize(message.header.micros)
+    BinarySize(message.header.ticks)
     + BinarySize(message.header.file_name)
     + BinarySize(message.header.line_number)
     + BinarySize(message.header.severity);
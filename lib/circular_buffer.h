@@ -48,10 +48,7 @@ public:
 
   void pop_front() {
     CHECK(!empty());
-    {
-      T null;
-      buffer_[head_].swap(null);
-    }
+    buffer_[head_] = T();  // Release resources held by the element, if any.
     WrapAround(++head_);
     --size_;
   }
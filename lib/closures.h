@@ -2,11 +2,15 @@
 #pragma once
 
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 
 class Closures {
 public:
+  // Returns a callable that calls f with given args. Captures f and args by
+  // value (moves if rvalues). The returned callable is move-only if any of them
+  // is, and is meant to be called once, eg. when stored as an InlineFunction.
   // TODO: Replace with std::bind?
   template <typename F, typename... Args>
   static auto Bind(F&&f, Args&&... args) {
@@ -16,4 +20,11 @@ public:
         std::apply(std::move(f), std::move(args));
       };
   }
+
+  // Bind() overload for no args. Returns (a copy of) f itself, without
+  // a wrapper and an empty tuple, to keep the callable as small as possible.
+  template <typename F>
+  static std::decay_t<F> Bind(F&& f) {
+    return std::forward<F>(f);
+  }
 };
@@ -0,0 +1,187 @@
+#pragma once
+
+#if !defined __cpp_impl_coroutine
+#error "Coroutines require C++20 (-std=c++20)."
+#endif
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "lib/check.h"
+#include "lib/promise.h"
+
+
+// C++20 coroutine support: allows asynchronous code to be written as
+// straight-line code with co_await, instead of a chain of Then() handlers.
+//
+// Coroutine frames are allocated from fixed-size pools (CoroutineFramePool),
+// not from the heap. A frame's size is determined by the compiler; it is
+// checked against the pool's frame size when the frame is allocated.
+//
+// Awaitables:
+//   * Promise<T>: co_await promise resumes the coroutine with the promise's
+//     value once it is resolved,
+//   * scheduler-based ones in os/scheduler-coroutine.h: SleepMicros(),
+//     OncePinState().
+//
+// Eg.
+//   Promise<Reading> ReadDistance() {
+//     trig_pin_.SetHigh();
+//     co_await SleepMicros(10, TaskPriority::TIME_CRITICAL);
+//     trig_pin_.SetLow();
+//     const uint32_t high = co_await OncePinState<50>(echo_pin_, HIGH);
+//     const uint32_t low = co_await OncePinState<50>(echo_pin_, LOW);
+//     co_return Reading{ToDistance(low - high), high};
+//   }
+
+
+// Fixed pool of max_frames coroutine frames, of up to frame_size bytes each.
+template <size_t frame_size, uint8_t max_frames>
+class CoroutineFramePool {
+public:
+  static_assert(max_frames > 0 && max_frames <= 32, "1 to 32 frames.");
+  static_assert(frame_size % alignof(std::max_align_t) == 0,
+                "Frame size not a multiple of the frame alignment.");
+
+  static constexpr size_t FRAME_SIZE = frame_size;
+
+  void* Allocate(size_t size) {
+    CHECK(size <= frame_size);  // Else increase the pool's frame_size.
+    CHECK(used_ != ALL_USED);   // Else increase the pool's max_frames.
+    uint8_t frame = 0;
+    while (used_ & (uint32_t(1) << frame)) {
+      ++frame;
+    }
+    used_ |= uint32_t(1) << frame;
+    return frames_[frame].data();
+  }
+
+  void Free(void* p) {
+    const uint8_t frame =
+      (static_cast<Frame*>(p) - frames_.data());
+    CHECK(frame < max_frames && (used_ & (uint32_t(1) << frame)));
+    used_ &= ~(uint32_t(1) << frame);
+  }
+
+  uint8_t num_allocated() const {
+    uint8_t n = 0;
+    for (uint32_t used = used_; used; used &= used - 1) {
+      ++n;
+    }
+    return n;
+  }
+
+private:
+  static constexpr uint32_t ALL_USED =
+    max_frames == 32 ? ~uint32_t(0) : (uint32_t(1) << max_frames) - 1;
+
+  using Frame = std::array<unsigned char, frame_size>;
+
+  alignas(std::max_align_t) std::array<Frame, max_frames> frames_;
+  uint32_t used_ = 0;  // Bit per frame.
+};
+
+
+namespace internal::coroutine {
+
+// Base of coroutine promise types: allocates frames from a pool, shared by
+// coroutines with the same pool parameters. Coroutines start eagerly and
+// their frames are freed once they complete.
+template <size_t frame_size, uint8_t max_frames>
+struct PooledPromise {
+  using Pool = CoroutineFramePool<frame_size, max_frames>;
+  static inline Pool pool;
+
+  static void* operator new(size_t size) { return pool.Allocate(size); }
+  static void operator delete(void* p) { pool.Free(p); }
+
+  std::suspend_never initial_suspend() const noexcept { return {}; }
+  std::suspend_never final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { CHECK(false); }
+};
+
+constexpr size_t DEFAULT_FRAME_SIZE = 128;
+constexpr uint8_t DEFAULT_MAX_FRAMES = 4;
+
+}  // namespace internal::coroutine
+
+
+// Return type of a fire-and-forget coroutine: it runs until its first
+// co_await when called, then continues when the awaited event occurs.
+// Frames of coroutines returning Coroutine<frame_size, max_frames> come from
+// a pool of max_frames frames of frame_size bytes.
+template <size_t frame_size = internal::coroutine::DEFAULT_FRAME_SIZE,
+          uint8_t max_frames = internal::coroutine::DEFAULT_MAX_FRAMES>
+class Coroutine {
+public:
+  struct promise_type
+    : internal::coroutine::PooledPromise<frame_size, max_frames> {
+    Coroutine get_return_object() const { return {}; }
+    void return_void() const {}
+  };
+
+  using Pool = typename promise_type::Pool;
+  static Pool& pool() { return promise_type::pool; }
+};
+
+
+// A coroutine may return Promise<T>: the promise is resolved with the value
+// of co_return. Frames come from the default pool.
+template <typename T, typename... Args>
+struct std::coroutine_traits<Promise<T>, Args...> {
+  struct promise_type : internal::coroutine::PooledPromise<
+      internal::coroutine::DEFAULT_FRAME_SIZE,
+      internal::coroutine::DEFAULT_MAX_FRAMES> {
+    Promise<T> get_return_object() const { return promise; }
+    void return_value(T value) { promise.Resolve(std::move(value)); }
+
+    PromiseWithResolve<T> promise;
+  };
+};
+
+template <typename... Args>
+struct std::coroutine_traits<Promise<void>, Args...> {
+  struct promise_type : internal::coroutine::PooledPromise<
+      internal::coroutine::DEFAULT_FRAME_SIZE,
+      internal::coroutine::DEFAULT_MAX_FRAMES> {
+    Promise<void> get_return_object() const { return promise; }
+    void return_void() { promise.Resolve(); }
+
+    PromiseWithResolve<void> promise;
+  };
+};
+
+
+// co_await promise: resumes the coroutine, in a new call stack, once the
+// promise is resolved. Returns the promise's value.
+template <typename T>
+auto operator co_await(Promise<T> promise) {
+  struct Awaiter {
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> coroutine) {
+      if constexpr (!std::is_void_v<T>) {
+        promise.ThenVoid([this, coroutine](T&& value) {
+          value_.emplace(std::move(value));
+          coroutine.resume();
+        });
+      } else {
+        promise.ThenVoid([coroutine]() { coroutine.resume(); });
+      }
+    }
+
+    T await_resume() {
+      if constexpr (!std::is_void_v<T>) {
+        return std::move(*value_);
+      }
+    }
+
+    Promise<T> promise;
+    std::optional<fix_void_t<T>> value_;
+  };
+  return Awaiter{std::move(promise), {}};
+}
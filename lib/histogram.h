@@ -0,0 +1,48 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+
+// Counts of values in num_buckets buckets of exponentially growing width:
+// bucket 0 counts values below 2^min_bits, bucket i > 0 values in
+// [2^(min_bits + i - 1), 2^(min_bits + i)), the last bucket also all larger
+// values. Eg. for microseconds with min_bits = 2 (4 usec timer resolution):
+// 0-3, 4-7, 8-15, 16-31, ... usec.
+//
+// Compact: 2 bytes per bucket. Counts saturate at 65535 rather than wrap.
+template <uint8_t num_buckets, uint8_t min_bits = 2>
+class Histogram {
+public:
+  static constexpr uint8_t NUM_BUCKETS = num_buckets;
+
+  void Add(uint32_t value) {
+    uint16_t& count = counts_[Bucket(value)];
+    if (count != UINT16_MAX) {
+      ++count;
+    }
+  }
+
+  uint16_t count(uint8_t bucket) const { return counts_[bucket]; }
+
+  // Lowest value counted in given bucket.
+  static constexpr uint32_t bucket_min(uint8_t bucket) {
+    return bucket == 0 ? 0 : uint32_t(1) << (min_bits + bucket - 1);
+  }
+
+  void Reset() { counts_.fill(0); }
+
+  static uint8_t Bucket(uint32_t value) {
+    value >>= min_bits;
+    uint8_t bucket = 0;
+    while (value && bucket < num_buckets - 1) {
+      value >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+private:
+  std::array<uint16_t, num_buckets> counts_ = {};
+};
@@ -0,0 +1,44 @@
+#include <cassert>
+#include <cstdint>
+
+#include "lib/histogram.h"
+
+
+int main() {
+  {
+    using HistogramT = Histogram<5, 2>;  // 0-3, 4-7, 8-15, 16-31, 32-...
+    assert(HistogramT::Bucket(0) == 0);
+    assert(HistogramT::Bucket(3) == 0);
+    assert(HistogramT::Bucket(4) == 1);
+    assert(HistogramT::Bucket(15) == 2);
+    assert(HistogramT::Bucket(16) == 3);
+    assert(HistogramT::Bucket(32) == 4);
+    assert(HistogramT::Bucket(UINT32_MAX) == 4);
+    assert(HistogramT::bucket_min(0) == 0);
+    assert(HistogramT::bucket_min(1) == 4);
+    assert(HistogramT::bucket_min(4) == 32);
+
+    HistogramT histogram;
+    histogram.Add(1);
+    histogram.Add(2);
+    histogram.Add(10);
+    histogram.Add(1000000);
+    assert(histogram.count(0) == 2);
+    assert(histogram.count(1) == 0);
+    assert(histogram.count(2) == 1);
+    assert(histogram.count(4) == 1);
+    histogram.Reset();
+    assert(histogram.count(0) == 0);
+  }
+
+  {
+    // Counts saturate.
+    Histogram<2> histogram;
+    for (uint32_t i = 0; i < 70000; ++i) {
+      histogram.Add(0);
+    }
+    assert(histogram.count(0) == UINT16_MAX);
+  }
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "lib/check.h"
+
+
+// Binary min-heap of small integer indices 0..capacity-1 (eg. of slots in
+// an external fixed-size array), each with a key. Tracks the position of each
+// index in the heap, so that any index can be removed or re-keyed in O(log n),
+// not only the top one.
+//
+// Sifting moves 1-byte indices only; keys and the elements the indices refer to
+// stay in place.
+template <typename KeyT, uint8_t capacity, typename LessT = std::less<KeyT>>
+class IndexedHeap {
+public:
+  using Index = uint8_t;
+  static constexpr Index NONE = 0xFF;
+
+  static_assert(capacity < NONE, "Too large capacity for 8-bit indices.");
+
+  IndexedHeap() { position_.fill(NONE); }
+
+  bool empty() const { return size_ == 0; }
+  uint8_t size() const { return size_; }
+  bool contains(Index index) const { return position_[index] != NONE; }
+
+  // Index with the least key.
+  Index top() const {
+    CHECK(!empty());
+    return heap_[0];
+  }
+
+  const KeyT& key(Index index) const { return keys_[index]; }
+
+  void Insert(Index index, const KeyT& key) {
+    CHECK(index < capacity && !contains(index));
+    keys_[index] = key;
+    Place(size_++, index);
+    SiftUp(position_[index]);
+  }
+
+  void Remove(Index index) {
+    CHECK(contains(index));
+    const uint8_t position = position_[index];
+    position_[index] = NONE;
+    const Index last = heap_[--size_];
+    if (position != size_) {
+      Place(position, last);
+      Fix(position);
+    }
+  }
+
+  void Pop() { Remove(top()); }
+
+  // Changes the key of an index in the heap, moving it up or down as needed.
+  void Update(Index index, const KeyT& key) {
+    CHECK(contains(index));
+    keys_[index] = key;
+    Fix(position_[index]);
+  }
+
+private:
+  bool Less(uint8_t position_a, uint8_t position_b) const {
+    return LessT()(keys_[heap_[position_a]], keys_[heap_[position_b]]);
+  }
+
+  void Place(uint8_t position, Index index) {
+    heap_[position] = index;
+    position_[index] = position;
+  }
+
+  void Swap(uint8_t position_a, uint8_t position_b) {
+    const Index index_a = heap_[position_a];
+    Place(position_a, heap_[position_b]);
+    Place(position_b, index_a);
+  }
+
+  void Fix(uint8_t position) {
+    if (position > 0 && Less(position, (position - 1) / 2)) {
+      SiftUp(position);
+    } else {
+      SiftDown(position);
+    }
+  }
+
+  void SiftUp(uint8_t position) {
+    while (position > 0) {
+      const uint8_t parent = (position - 1) / 2;
+      if (!Less(position, parent)) {
+        break;
+      }
+      Swap(position, parent);
+      position = parent;
+    }
+  }
+
+  void SiftDown(uint8_t position) {
+    while (true) {
+      const uint8_t left = 2 * position + 1;
+      if (left >= size_) {
+        break;
+      }
+      const uint8_t right = left + 1;
+      const uint8_t child =
+        (right < size_ && Less(right, left)) ? right : left;
+      if (!Less(child, position)) {
+        break;
+      }
+      Swap(position, child);
+      position = child;
+    }
+  }
+
+  std::array<KeyT, capacity> keys_;       // By index.
+  std::array<Index, capacity> heap_;      // By position in the heap.
+  std::array<uint8_t, capacity> position_;  // By index.
+  uint8_t size_ = 0;
+};
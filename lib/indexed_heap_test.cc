@@ -0,0 +1,72 @@
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "lib/indexed_heap.h"
+
+using namespace std;
+
+
+template <typename HeapT>
+vector<uint8_t> PopAll(HeapT* heap) {
+  vector<uint8_t> indices;
+  while (!heap->empty()) {
+    indices.push_back(heap->top());
+    heap->Pop();
+  }
+  return indices;
+}
+
+
+int main() {
+  {
+    IndexedHeap<uint32_t, 8> heap;
+    assert(heap.empty());
+    heap.Insert(0, 30);
+    heap.Insert(1, 10);
+    heap.Insert(2, 20);
+    heap.Insert(3, 5);
+    assert(heap.size() == 4);
+    assert(heap.top() == 3);
+    assert(heap.key(2) == 20);
+    assert(PopAll(&heap) == vector<uint8_t>({3, 1, 2, 0}));
+  }
+
+  {
+    // Remove from the middle of the heap.
+    IndexedHeap<uint32_t, 8> heap;
+    for (uint8_t i = 0; i < 8; ++i) {
+      heap.Insert(i, 100 - 10 * i);
+    }
+    heap.Remove(5);
+    heap.Remove(7);  // The top.
+    heap.Remove(0);  // The last one.
+    assert(!heap.contains(5));
+    assert(heap.contains(4));
+    assert(PopAll(&heap) == vector<uint8_t>({6, 4, 3, 2, 1}));
+  }
+
+  {
+    // Update keys up and down.
+    IndexedHeap<uint32_t, 8> heap;
+    for (uint8_t i = 0; i < 5; ++i) {
+      heap.Insert(i, 10 * i);
+    }
+    heap.Update(0, 25);
+    heap.Update(4, 5);
+    assert(PopAll(&heap) == vector<uint8_t>({4, 1, 2, 0, 3}));
+  }
+
+  {
+    // Indices are reusable after removal.
+    IndexedHeap<uint32_t, 2> heap;
+    heap.Insert(0, 1);
+    heap.Insert(1, 2);
+    heap.Pop();
+    heap.Insert(0, 3);
+    assert(PopAll(&heap) == vector<uint8_t>({1, 0}));
+  }
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+template <typename Signature, size_t capacity>
+class InlineFunction;
+
+// Type-erased callable, like std::function, but stored inline - in a fixed-size
+// buffer inside the InlineFunction instance - rather than on the heap.
+// Constructing, moving and destroying an InlineFunction never allocates.
+//
+// Move-only: the stored callable is moved, never copied, so that it can capture
+// move-only objects (and so that no copy of a capture is made by accident).
+//
+// A callable larger than capacity bytes is rejected at compile time. Either
+// capture less (eg. a pointer instead of a large object) or increase capacity.
+//
+// Meant for storing callables in fixed-capacity containers (eg. scheduler task
+// queues), where a std::function would allocate for most non-trivial lambdas.
+template <typename R, typename... Args, size_t capacity>
+class InlineFunction<R(Args...), capacity> {
+  template <typename F>
+  using enable_if_callable_t = std::enable_if_t<
+    !std::is_same_v<std::decay_t<F>, InlineFunction>
+    && std::is_invocable_r_v<R, std::decay_t<F>&, Args...>>;
+
+public:
+  InlineFunction() : ops_(nullptr) {}
+  InlineFunction(std::nullptr_t) : ops_(nullptr) {}
+
+  template <typename F, typename = enable_if_callable_t<F>>  // SFINAE
+  InlineFunction(F&& f) {
+    using FT = std::decay_t<F>;
+    static_assert(sizeof(FT) <= capacity,
+                  "Callable does not fit in InlineFunction. "
+                  "Capture less or increase capacity.");
+    static_assert(alignof(FT) <= alignof(Storage),
+                  "Callable alignment too strict for InlineFunction.");
+    new (&storage_) FT(std::forward<F>(f));
+    ops_ = &ops_v<FT>;
+  }
+
+  InlineFunction(InlineFunction&& other) : ops_(other.ops_) {
+    if (ops_) {
+      ops_->move(&other.storage_, &storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  InlineFunction& operator=(InlineFunction&& other) {
+    if (this != &other) {
+      reset();
+      if (other.ops_) {
+        other.ops_->move(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  InlineFunction& operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator=(const InlineFunction&) = delete;
+
+  ~InlineFunction() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  R operator()(Args... args) {
+    return ops_->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  void swap(InlineFunction& other) {
+    InlineFunction tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+  void reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  using Storage = std::aligned_storage_t<capacity, alignof(std::max_align_t)>;
+
+  // Operations on the stored callable, specific to its type.
+  // One (constexpr, in flash on AVR) instance per stored callable type.
+  struct Ops {
+    R (*invoke)(void* f, Args&&... args);
+    void (*move)(void* from, void* to);  // Move-constructs, destroys from.
+    void (*destroy)(void* f);
+  };
+
+  template <typename F>
+  static R Invoke(void* f, Args&&... args) {
+    return (*static_cast<F*>(f))(std::forward<Args>(args)...);
+  }
+
+  template <typename F>
+  static void Move(void* from, void* to) {
+    new (to) F(std::move(*static_cast<F*>(from)));
+    static_cast<F*>(from)->~F();
+  }
+
+  template <typename F>
+  static void Destroy(void* f) {
+    static_cast<F*>(f)->~F();
+  }
+
+  template <typename F>
+  static constexpr Ops ops_v = {&Invoke<F>, &Move<F>, &Destroy<F>};
+
+  const Ops* ops_;
+  Storage storage_;
+};
@@ -0,0 +1,66 @@
+
+#include <cassert>
+#include <memory>
+
+#include "lib/inline_function.h"
+#include "lib/testing/allocation_counter.h"
+
+
+int main() {
+  {
+    int a = 0;
+    InlineFunction<void(int), 16> f([&a](int i) { a += i; });
+    assert(f);
+    f(2);
+    f(3);
+    assert(a == 5);
+  }
+
+  {
+    InlineFunction<int(int), 16> f;
+    assert(!f);
+    f = [](int i) { return i + 1; };
+    assert(f(1) == 2);
+    f = nullptr;
+    assert(!f);
+  }
+
+  {
+    // Move-only capture. Moving the function moves the capture.
+    auto p = std::make_unique<int>(1);
+    InlineFunction<int(), 16> f([p = std::move(p)]() { return *p; });
+    InlineFunction<int(), 16> g(std::move(f));
+    assert(!f);
+    assert(g() == 1);
+    InlineFunction<int(), 16> h;
+    h.swap(g);
+    assert(!g);
+    assert(h() == 1);
+  }
+
+  {
+    // The capture is destroyed with the function.
+    auto p = std::make_shared<int>(1);
+    {
+      InlineFunction<void(), 32> f([p]() {});
+      assert(p.use_count() == 2);
+      InlineFunction<void(), 32> g;
+      g = std::move(f);
+      assert(p.use_count() == 2);
+    }
+    assert(p.use_count() == 1);
+  }
+
+  {
+    // Construction, move and call do not allocate.
+    AllocationCounter allocations;
+    int a = 0, b = 0, c = 0;
+    InlineFunction<void(), 32> f([&a, &b, &c]() { ++a; ++b; ++c; });
+    InlineFunction<void(), 32> g(std::move(f));
+    g();
+    assert(a == 1 && b == 1 && c == 1);
+    assert(allocations.count() == 0);
+  }
+
+  return 0;
+}
@@ -7,6 +7,7 @@
 #include "arduino-ext/pgm.h"
 #include "lib/tuples.h"
 #include "os/thread.h"
+#include "os/ticks.h"
 
 
 enum class Severity : uint8_t {
@@ -16,7 +17,7 @@ enum class Severity : uint8_t {
 
 
 struct MessageHeader {
-  uint32_t micros;
+  uint32_t ticks;  // Of the timer, see TimePoint. Converted to usec by readers.
   const PGM<char>* file_name;
   uint16_t line_number;
   Thread::Id thread_id;
@@ -38,18 +39,18 @@ public:
   class MessageBuilder;
 
   MessageBuilder<> BeginMessage(
-    Severity severity, uint32_t micros, Thread::Id thread_id,
+    Severity severity, TimePoint time, Thread::Id thread_id,
     const PGM<char>* file_name, uint16_t line_number) volatile {
     return MessageBuilder<>(
-      this, severity, micros, thread_id,
+      this, severity, time, thread_id,
       file_name, line_number, false /* is_async */);
   }
 
   MessageBuilder<> BeginAsyncMessage(
-    Severity severity, uint32_t micros, Thread::Id thread_id,
+    Severity severity, TimePoint time, Thread::Id thread_id,
     const PGM<char>* file_name, uint16_t line_number) volatile {
     return MessageBuilder<>(
-      this, severity, micros, thread_id,
+      this, severity, time, thread_id,
       file_name, line_number, true /* is_async */);
   }
 
@@ -81,11 +82,11 @@ public:
 
   private:
     MessageBuilder(volatile LogInterface* log,
-                   Severity severity, uint32_t micros, Thread::Id thread_id,
+                   Severity severity, TimePoint time, Thread::Id thread_id,
                    const PGM<char>* file_name, uint16_t line_number,
                    bool is_async)
       : log_(log),
-        header_({micros, file_name, line_number, thread_id, severity}),
+        header_({time.ticks(), file_name, line_number, thread_id, severity}),
         is_async_(is_async) {}
 
     MessageBuilder(volatile LogInterface* log, const MessageHeader& header,
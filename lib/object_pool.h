@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "lib/check.h"
+
+
+// Fixed-capacity pool of objects of type T: allocation without the heap,
+// in O(1), and without per-object overhead. Freed slots are kept in a list
+// threaded through their storage, and reused first. Slots never used are
+// handed out in order, so that a pool is constant-initialized: a global pool
+// is ready before any constructor runs.
+//
+// Counts objects in use and their high-water mark, to size the pool.
+template <typename T, uint8_t capacity>
+class ObjectPool {
+public:
+  static_assert(capacity > 0, "Empty pool.");
+
+  static constexpr uint8_t CAPACITY = capacity;
+
+  // Constructs an object in a free slot. Returns nullptr if none is free.
+  template <typename... Args>
+  T* New(Args&&... args) {
+    Slot* slot = free_;
+    if (slot) {
+      free_ = slot->next;
+    } else if (num_used_slots_ < capacity) {
+      slot = &slots_[num_used_slots_++];
+    } else {
+      return nullptr;
+    }
+    if (++size_ > high_water_mark_) {
+      high_water_mark_ = size_;
+    }
+    return new (slot->object) T(std::forward<Args>(args)...);
+  }
+
+  // Destroys an object returned by New(), and frees its slot.
+  void Delete(T* t) {
+    CHECK(size_ > 0);
+    t->~T();
+    Slot* const slot = reinterpret_cast<Slot*>(t);
+    slot->next = free_;
+    free_ = slot;
+    --size_;
+  }
+
+  // Objects in use.
+  uint8_t size() const { return size_; }
+
+  // Max objects in use at a time, since the start or ResetHighWaterMark().
+  uint8_t high_water_mark() const { return high_water_mark_; }
+
+  void ResetHighWaterMark() { high_water_mark_ = size_; }
+
+private:
+  union Slot {
+    Slot* next;  // While free.
+    alignas(T) unsigned char object[sizeof(T)];
+  };
+
+  Slot slots_[capacity] = {};
+  Slot* free_ = nullptr;
+  uint8_t num_used_slots_ = 0;  // Ever used: slots_[num_used_slots_..] are free.
+  uint8_t size_ = 0;
+  uint8_t high_water_mark_ = 0;
+};
@@ -0,0 +1,46 @@
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#include "lib/object_pool.h"
+
+
+int main() {
+  {
+    ObjectPool<std::string, 3> pool;
+    std::string* const a = pool.New("a");
+    std::string* const b = pool.New(2, 'b');
+    std::string* const c = pool.New();
+    assert(*a == "a" && *b == "bb" && c->empty());
+    assert(pool.size() == 3 && pool.high_water_mark() == 3);
+    assert(!pool.New("d"));  // Exhausted.
+
+    // Freed slots are reused, last freed first.
+    pool.Delete(b);
+    pool.Delete(a);
+    assert(pool.size() == 1 && pool.high_water_mark() == 3);
+    assert(pool.New("e") == a);
+    assert(pool.New("f") == b);
+    assert(*a == "e" && *b == "f");
+
+    pool.Delete(a);
+    pool.Delete(b);
+    pool.Delete(c);
+    pool.ResetHighWaterMark();
+    assert(pool.size() == 0 && pool.high_water_mark() == 0);
+    pool.Delete(pool.New());
+    assert(pool.high_water_mark() == 1);
+  }
+
+  {
+    // Aligned for T.
+    struct alignas(8) Aligned {
+      char c;
+    };
+    ObjectPool<Aligned, 2> pool;
+    pool.New();
+    assert(reinterpret_cast<uintptr_t>(pool.New()) % 8 == 0);
+  }
+
+  return 0;
+}
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <queue>
+#include <utility>
 #include <vector>
 #include "lib/check.h"
 
@@ -26,16 +27,25 @@ public:
   // https://stackoverflow.com/questions/19467485
   template <typename F>
   void RemoveSingle(F&& predicate) {
+    [[maybe_unused]] const bool removed = RemoveIf(std::forward<F>(predicate));
+    CHECK(removed);
+  }
+
+  // Removes the first element matching the predicate. Returns whether found.
+  template <typename F>
+  bool RemoveIf(F&& predicate) {
     auto it = std::find_if(c.begin(), c.end(), predicate);
-    CHECK(it != c.end());
+    if (it == c.end()) {
+      return false;
+    }
     if (&(*it) != &c.back()) {
       *it = std::move(c.back());
       c.pop_back();
       Order();
     } else {
-      c.pop_back();
-      // TODO: Need to Order()?
+      c.pop_back();  // Removing the last element preserves the heap property.
     }
+    return true;
   }
 
   void Order() {
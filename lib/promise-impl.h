@@ -2,164 +2,368 @@
 
 #pragma once
 
-#include <functional>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
 #include "lib/check.h"
+#include "lib/inline_function.h"
+#include "lib/object_pool.h"
 #include "lib/template_metaprogramming.h"
 #include "os/scheduler_executor-global.h"
+#include "os/thread.h"
 
 template <typename T> class Promise;
+template <typename T> class PromiseWithResolve;
+template <typename T> class PromiseState;
+
+
+// Max number of PromiseStates of each type T alive at a time: of Promise<T>
+// instances not yet resolved, or resolved but still referenced. Exceeding it
+// fails a CHECK. To be specialized for types that need more, or less, eg.
+//   template <> inline constexpr uint8_t promise_pool_capacity<Reading> = 12;
+// See PromiseStatePool<T>::high_water_mark() for sizing.
+template <typename T>
+inline constexpr uint8_t promise_pool_capacity = 8;
+
+// Per type fixed pool of PromiseStates: promises do not use the heap.
+template <typename T>
+using PromiseStatePool = ObjectPool<PromiseState<T>, promise_pool_capacity<T>>;
+
+template <typename T>
+inline PromiseStatePool<T> promise_state_pool;
+
+
+// Shared pointer to a PromiseState, held by Promise instances and by pending
+// value handlers. Intrusive: the reference count is a byte of the state. The
+// state is returned to its pool when the last pointer to it is gone.
+//
+// Not interrupt-safe: neither the count nor the pool's free list is updated
+// in a critical section. Hence a promise is never copied or released by an
+// interrupt handler, eg. captured in a callable it passes to RunAsync().
+template <typename T>
+class PromiseStatePtr {
+public:
+  PromiseStatePtr() = default;
+
+  // Takes a state from the pool.
+  template <typename... Args>
+  static PromiseStatePtr Make(Args&&... args) {
+    PromiseState<T>* const state =
+      promise_state_pool<T>.New(std::forward<Args>(args)...);
+    CHECK(state && "Promise pool exhausted, see promise_pool_capacity.");
+    return PromiseStatePtr(state);
+  }
+
+  PromiseStatePtr(const PromiseStatePtr& other) : state_(other.state_) {
+    AddRef();
+  }
+
+  PromiseStatePtr(PromiseStatePtr&& other) : state_(other.state_) {
+    other.state_ = nullptr;
+  }
+
+  PromiseStatePtr& operator=(PromiseStatePtr other) {
+    std::swap(state_, other.state_);
+    return *this;
+  }
+
+  ~PromiseStatePtr() {
+    if (state_ && --state_->refcount_ == 0) {
+      promise_state_pool<T>.Delete(state_);
+    }
+  }
+
+  PromiseState<T>* get() const { return state_; }
+  PromiseState<T>* operator->() const { return state_; }
+
+private:
+  // Intrusive: a state may share itself.
+  explicit PromiseStatePtr(PromiseState<T>* state) : state_(state) {
+    AddRef();
+  }
+
+  friend class PromiseState<T>;
+
+  void AddRef() {
+    if (state_) {
+      CHECK(state_->refcount_ < UINT8_MAX);
+      ++state_->refcount_;
+    }
+  }
+
+  PromiseState<T>* state_ = nullptr;
+};
+
+
+// Max size of a value handler's captures. A handler passed to Then() shares
+// the space with a pointer to the child promise's state.
+inline constexpr size_t PROMISE_HANDLER_CAPACITY = 4 * sizeof(void*);
+
+
+// How the value handler of a promise is run, see Promise::Inline().
+enum class Continuation : uint8_t {
+  ASYNC,   // In a new call stack, via the executor.
+  INLINE,  // Right away, in the call stack that resolves the promise or that
+           // registers the handler, up to MAX_INLINE_CONTINUATION_DEPTH.
+};
+
+// Max number of value handlers run inline nested in one another, eg. along
+// a chain of already resolved promises. Beyond, handlers are run via the
+// executor, in a new call stack: bounds the stack usage of a chain.
+inline constexpr uint8_t MAX_INLINE_CONTINUATION_DEPTH = 4;
+
+namespace internal::promise {
+
+// Of value handlers being run inline, see MAX_INLINE_CONTINUATION_DEPTH.
+inline uint8_t inline_depth = 0;
+
+}  // namespace internal::promise
 
 
 template <typename T>
 struct promise_t_impl {
   using type = Promise<T>;
+  static constexpr bool is_promise = false;
 };
 
 template <typename T>
 struct promise_t_impl<Promise<T>> {
   using type = Promise<T>;
+  static constexpr bool is_promise = true;
+};
+
+template <typename T>
+struct promise_t_impl<PromiseWithResolve<T>> {
+  using type = Promise<T>;
+  static constexpr bool is_promise = true;
 };
 
 template <typename T>
 using promise_t = typename promise_t_impl<T>::type;
 
+template <typename T>
+inline constexpr bool is_promise_v = promise_t_impl<T>::is_promise;
+
+
+// Result of value handler F of a Promise<ArgT>.
+template <typename F, typename ArgT>
+struct handler_result {
+  using type = std::invoke_result_t<std::decay_t<F>&, ArgT&&>;
+};
+
+template <typename F>
+struct handler_result<F, void> {
+  using type = std::invoke_result_t<std::decay_t<F>&>;
+};
+
+template <typename F, typename ArgT>
+using handler_result_t = typename handler_result<F, ArgT>::type;
+
 
-template <typename ResultT, typename ArgT>
+template <typename ArgT>
 struct value_handler {
-  using type = std::function<ResultT(const ArgT&)>;
+  using type = InlineFunction<void(ArgT&&), PROMISE_HANDLER_CAPACITY>;
 };
 
-template <typename ResultT>
-struct value_handler<ResultT, void> {
-  using type = std::function<ResultT(void)>;
+template <>
+struct value_handler<void> {
+  using type = InlineFunction<void(), PROMISE_HANDLER_CAPACITY>;
 };
 
-template <typename ResultT, typename ArgT>
-using value_handler_t = typename value_handler<ResultT, ArgT>::type;
+// Type-erased value handler of a Promise<ArgT>, stored inline in its state.
+// Passed the value as an rvalue, moved out of the state: the value is moved,
+// not copied, along a chain, and may be move-only. Takes it as T, T&& or
+// const T&.
+template <typename ArgT>
+using value_handler_t = typename value_handler<ArgT>::type;
 
 
   
 template <typename T>
 class PromiseState {
   using State = PromiseState<T>;
+  using StatePtr = PromiseStatePtr<T>;
 
 public:
   PromiseState() { }
 
-  template <typename T_ = T, typename = enable_if_not_void_t<T_>>
-  PromiseState(const T_& value) : value_(value) { }
+  // Resolved. With true if T is void.
+  template <typename U>
+  explicit PromiseState(U&& value)
+    : value_(std::in_place, std::forward<U>(value)) { }
 
-  template <typename ChildTOrPromiseChildT,
-            typename PromiseChildT = promise_t<ChildTOrPromiseChildT>>
-  PromiseChildT Then(value_handler_t<ChildTOrPromiseChildT, T>&& f) {
-    CHECK(!on_resolved_);
-    PromiseChildT child;
-    // TODO: bind.
+  // The handler and the child's state are stored in a single value handler:
+  // no allocation, and a single indirect call when the value is available.
+  template <typename F,
+            typename ChildPromiseT = promise_t<handler_result_t<F, T>>>
+  ChildPromiseT Then(F&& f) {
+    CHECK(!on_resolved_ && !consumed_);
+    ChildPromiseT child;
+    child.state_->continuation_ = continuation_;  // The chain's policy.
     if constexpr (!std::is_void_v<T>) {
       on_resolved_ =
-        [f_ = std::move(f), child_state = child.state_](const T& value) mutable {
-          CallFuncAndResolveChild<ChildTOrPromiseChildT>(
-            std::move(f_), value, std::move(child_state));
+        [f_ = std::forward<F>(f), child_state = child.state_](
+          T&& value) mutable {
+          CallFuncAndResolveChild(f_, std::move(child_state), std::move(value));
         };
     } else {
       on_resolved_ =
-        [f_ = std::move(f), child_state = child.state_]() mutable {
-          CallFuncAndResolveChild<ChildTOrPromiseChildT>(
-            std::move(f_), std::move(child_state));
+        [f_ = std::forward<F>(f), child_state = child.state_]() mutable {
+          CallFuncAndResolveChild(f_, std::move(child_state));
         };
     }
     if (is_resolved()) {
-      if constexpr (!std::is_void_v<T>) {
-        executor.RunAsync(on_resolved_, value_.value());
-      } else {
-        executor.RunAsync(on_resolved_);
-      }
+      RunHandler();
     }
     return child;
   }
   
-  void ThenVoid(value_handler_t<void, T>&& f) {
-    CHECK(!on_resolved_);
-    if (!is_resolved()) {
-      on_resolved_ = std::move(f);
-    } else {  // is_resolved
-      if constexpr (!std::is_void_v<T>) {
-        executor.RunAsync(std::move(f), value_.value());
-      } else {
-        executor.RunAsync(std::move(f));
-      }
+  template <typename F>
+  void ThenVoid(F&& f) {
+    CHECK(!on_resolved_ && !consumed_);
+    on_resolved_ = std::forward<F>(f);
+    if (is_resolved()) {
+      RunHandler();
     }
   }
   
-  template <typename T_ = T, typename = enable_if_not_void_t<T_>>
-  static void Resolve(std::shared_ptr<State> this_ptr, const T_& value) {
+  // Copies or moves the value into the state.
+  template <typename U,
+            typename = std::enable_if_t<std::is_constructible_v<T, U&&>>>
+  static void Resolve(StatePtr this_ptr, U&& value) {
     State* const this_ = this_ptr.get();
     CHECK(!this_->is_resolved());
-    this_->value_ = value;
+    this_->value_.emplace(std::forward<U>(value));
     if (this_->on_resolved_) {
-      executor.RunAsync(this_->on_resolved_, value);
+      this_->RunHandler();
     }
   }
 
   template <typename T_ = T, typename = enable_if_is_void_t<T_>>
-  static void Resolve(std::shared_ptr<State> this_ptr) {
+  static void Resolve(StatePtr this_ptr) {
     State* const this_ = this_ptr.get();
     CHECK(!this_->is_resolved());
     this_->value_ = true;
     if (this_->on_resolved_) {
-      executor.RunAsync(this_->on_resolved_);
+      this_->RunHandler();
     }
   }
 
-  template <typename T_ = T, typename = enable_if_not_void_t<T_>>
-  static void Resolve(std::shared_ptr<State> this_ptr,
-                      Promise<T_>&& value_promise) {
-    value_promise.ThenVoid(
-      [this_ptr](const T& value) { Resolve(this_ptr, value); });
-  }
-
-  template <typename T_ = T, typename = enable_if_is_void_t<T_>>
-  static void Resolve(std::shared_ptr<State> this_ptr,
-                      Promise<void>&& value_promise) {
-    value_promise.ThenVoid([this_ptr]() { Resolve(this_ptr); });
+  // Resolves with the value of a nested promise, when it is resolved. Its
+  // handler is run as those of this promise's chain.
+  template <typename T_ = T, typename = std::enable_if_t<std::is_same_v<T_, T>>>
+  static void Resolve(StatePtr this_ptr, Promise<T_>&& value_promise) {
+    value_promise.state_->continuation_ = this_ptr->continuation_;
+    if constexpr (!std::is_void_v<T>) {
+      value_promise.ThenVoid(
+        [this_ptr](T&& value) { Resolve(this_ptr, std::move(value)); });
+    } else {
+      value_promise.ThenVoid([this_ptr]() { Resolve(this_ptr); });
+    }
   }
 
 public:
   bool is_resolved() const { return value_.has_value(); }
 
+  // Of a resolved state whose value has not been passed to a handler, eg.
+  // state of a combinator (see Promises), kept as a promise's value.
+  auto& value() { return *value_; }
+
+  void set_continuation(Continuation continuation) {
+    continuation_ = continuation;
+  }
+
 private:
-  template <typename ChildTOrPromiseChildT,
-            typename ChildPromiseT = promise_t<ChildTOrPromiseChildT>,
-            typename T_ = T, typename = enable_if_not_void_t<T_>>
-  static void CallFuncAndResolveChild(
-    std::function<ChildTOrPromiseChildT(const T_&)>&& f, const T_& value,
-    std::shared_ptr<typename ChildPromiseT::State> child_state) {
-    if constexpr (!std::is_void_v<ChildTOrPromiseChildT>) {
-      ChildPromiseT::State::Resolve(std::move(child_state), f(value));
+  // Runs the handler inline if so set and if the stack allows, see
+  // Continuation. Else runs it in a new call stack, with the value in the
+  // state: the executor's callable only holds a pointer to the state, which
+  // keeps it alive until then. Handlers are never run inline from interrupt
+  // handlers.
+  void RunHandler() {
+    if (continuation_ == Continuation::INLINE
+        && internal::promise::inline_depth < MAX_INLINE_CONTINUATION_DEPTH
+        && !Thread::is_interrupt()) {
+      const StatePtr this_ptr(this);  // In case the handler releases it.
+      ++internal::promise::inline_depth;
+      CallHandler();
+      --internal::promise::inline_depth;
     } else {
-      f(value);
-      ChildPromiseT::State::Resolve(std::move(child_state));
+      executor.RunAsync(
+        [this_ptr = StatePtr(this)]() { this_ptr->CallHandler(); });
     }
   }
 
-  template <typename ChildTOrPromiseChildT,
-            typename ChildPromiseT = promise_t<ChildTOrPromiseChildT>,
-            typename T_ = T, typename = enable_if_is_void_t<T_>>
-  static void CallFuncAndResolveChild(
-    std::function<ChildTOrPromiseChildT()>&& f,
-    std::shared_ptr<typename ChildPromiseT::State> child_state) {
-    if constexpr (!std::is_void_v<ChildTOrPromiseChildT>) {
-      ChildPromiseT::State::Resolve(std::move(child_state), f());
+  void CallHandler() {
+    if constexpr (!std::is_void_v<T>) {
+      consumed_ = true;  // A further handler would get a moved-from value.
+      on_resolved_(std::move(*value_));  // The one handler consumes it.
     } else {
-      f();
+      on_resolved_();
+    }
+    on_resolved_ = nullptr;  // Releases captures, eg. child states.
+  }
+
+  template <typename F, typename ChildStatePtr, typename... Args>
+  static void CallFuncAndResolveChild(F& f, ChildStatePtr&& child_state,
+                                      Args&&... value) {
+    using ResultT = handler_result_t<F, T>;
+    using ChildPromiseT = promise_t<ResultT>;
+    if constexpr (std::is_void_v<ResultT>) {
+      f(std::move(value)...);
       ChildPromiseT::State::Resolve(std::move(child_state));
+    } else if constexpr (is_promise_v<ResultT>) {
+      // Eg. a PromiseWithResolve, sliced.
+      ChildPromiseT::State::Resolve(std::move(child_state),
+                                    ChildPromiseT(f(std::move(value)...)));
+    } else {  // The result is moved into the child.
+      ChildPromiseT::State::Resolve(std::move(child_state),
+                                    f(std::move(value)...));
     }
   }
 
-  value_handler_t<void, T> on_resolved_;
+  friend class PromiseStatePtr<T>;
+  template <typename> friend class PromiseState;  // Of child promises.
+
+  value_handler_t<T> on_resolved_;
   std::optional<std::conditional_t<!std::is_void_v<T>, T, bool>> value_;
+  uint8_t refcount_ = 0;  // See PromiseStatePtr.
+  Continuation continuation_ = Continuation::ASYNC;
+  bool consumed_ = false;  // The value has been moved into the handler.
+};
+
+
+namespace internal::promise {
+
+// State of Promises::All(): values received so far.
+template <typename... Ts>
+struct AllState {
+  using Tuple = std::tuple<fix_void_t<Ts>...>;
+
+  template <size_t i, typename U>
+  void Set(U&& value) {
+    std::get<i>(values).emplace(std::forward<U>(value));
+    if (--num_pending == 0) {
+      Resolve(std::index_sequence_for<Ts...>());
+    }
+  }
+
+  template <size_t... is>
+  void Resolve(std::index_sequence<is...>) {
+    result.Resolve(Tuple(std::move(*std::get<is>(values))...));
+  }
+
+  std::tuple<std::optional<fix_void_t<Ts>>...> values;
+  uint8_t num_pending = sizeof...(Ts);
+  PromiseWithResolve<Tuple> result;
 };
+
+}  // namespace internal::promise
+
+// See Promises::All().
+template <typename... Ts>
+inline constexpr uint8_t
+  promise_pool_capacity<internal::promise::AllState<Ts...>> = 2;
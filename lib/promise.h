@@ -1,8 +1,9 @@
 
 #pragma once
 
-#include <functional>
-#include <memory>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 #include "lib/promise-impl.h"
@@ -52,34 +53,36 @@
 //   - without support for multiple Then() handlers per instance (at most one)
 //   - possibly without other features
 //
+// Promises are for the main thread: an interrupt handler must not create,
+// copy, resolve or release one (see PromiseStatePtr). It rather schedules
+// a task that does, without capturing a promise, see os/compare_match_lane.h.
+//
 // See https://developers.google.com/web/fundamentals/primers/promises
 // for a complete explanation of Promise interface and for an introduction
 // to programming with promises.
 template <typename T>
 class Promise {
 public:
+  using value_type = T;
   using State = PromiseState<T>;  // TOOD: private
+  using StatePtr = PromiseStatePtr<T>;
 
   // Registers a value handler to be called when the value is available
   // (= when the promise is resolved). Returns a child promise, resolved after
   // this promise is resolved and after the handler completes, with the
-  // handler's return value.
-  // The handler is run in a new call stack, sometime after the scope where
-  // Then() is called ends, even if the promise is already resovled.
-  template <typename ChildT>
-  Promise<ChildT> Then(value_handler_t<ChildT, T>&& handler) {
-    return state_->template Then<ChildT>(std::move(handler));
-  }
-
-  // Then() overload for a value handler returning a nested Promise.
-  // Then() returns a child promise which 'forwards' the nested promise
-  // returned by the value handler: the child promise is resolved when
-  // the nested promise is resolved, with the nested promise's value.
+  // handler's return value. The value is moved to the handler, and the
+  // handler's return value to the child promise: values are not copied along
+  // a chain, and may be move-only. The child promise's type is deduced from the
+  // handler, eg. Promise<int> for a handler returning an int.
+  // If the handler returns a nested Promise, the child promise 'forwards' it:
+  // it is resolved when the nested promise is resolved, with the nested
+  // promise's value.
   // The handler is run in a new call stack, sometime after the scope where
-  // Then() is called ends, even if the promise is already resovled.
-  template <typename ChildT>
-  Promise<ChildT> Then(value_handler_t<Promise<ChildT>, T>&& handler) {
-    return state_->template Then<Promise<ChildT>>(std::move(handler));
+  // Then() is called ends, even if the promise is already resovled. It is
+  // stored in the promise, see PROMISE_HANDLER_CAPACITY.
+  template <typename F>
+  promise_t<handler_result_t<F, T>> Then(F&& handler) {
+    return state_->Then(std::forward<F>(handler));
   }
 
   // Registers a value handler to be called when the value is available
@@ -87,31 +90,52 @@ public:
   // promise, ending the promise chain.
   // The handler is run in a new call stack, sometime after the scope where
   // ThenVoid() is called ends, even if the promise is already resovled.
-  void ThenVoid(value_handler_t<void, T>&& handler) {
-    state_->ThenVoid(std::move(handler));
+  template <typename F>
+  void ThenVoid(F&& handler) {
+    state_->ThenVoid(std::forward<F>(handler));
+  }
+
+  // Opts in to running value handlers inline: a handler is run right away,
+  // in the call stack that resolves the promise, or in Then() if the promise
+  // is already resolved, rather than via the executor in a new call stack.
+  // Saves a round trip through the scheduler per link of a chain. Applies to
+  // this promise and to the child promises of its Then(), ie. to the rest of
+  // the chain, eg.
+  //   ReadDistance().Inline().Then(ToObstacle).ThenVoid(Avoid);
+  // Not for handlers that take long: they delay the code resolving the
+  // promise. Nested handlers are run inline up to
+  // MAX_INLINE_CONTINUATION_DEPTH, and via the executor beyond, to bound the
+  // stack. Handlers are run via the executor when resolved from interrupts.
+  Promise& Inline() {
+    state_->set_continuation(Continuation::INLINE);
+    return *this;
   }
 
   // Creates a Promise that is already resolved with given value.
-  template <typename T_ = T, typename = enable_if_not_void_t<T_>>  // SFINAE
-  static Promise Resolved(const T_& value) {
-    return Promise(std::make_unique<State>(value));
+  template <typename U, typename T_ = T,
+            typename = enable_if_not_void_t<T_>>  // SFINAE
+  static Promise Resolved(U&& value) {
+    return Promise(StatePtr::Make(std::forward<U>(value)));
   }
 
   // Creates a Promise that is already resolved.
   template <typename T_ = T, typename = enable_if_is_void_t<T_>>  // SFINAE
   static Promise Resolved() {
-    return Promise(std::make_unique<State>(true));
+    return Promise(StatePtr::Make(true));
   }
 
   // TODO: Make this private. Client code should only consume the result
   // (via Then()).
   bool is_resolved() const { return state_->is_resolved(); }
 
+  // Of PromiseStates of Promise<T> instances, see promise_pool_capacity.
+  static const PromiseStatePool<T>& pool() { return promise_state_pool<T>; }
+
 public:  // TODO: protected
-  Promise() : state_(new State) { }
-  Promise(std::unique_ptr<State> state) : state_(state.release()) { }
+  Promise() : state_(StatePtr::Make()) { }
+  explicit Promise(StatePtr state) : state_(std::move(state)) { }
 
-  std::shared_ptr<State> state_;
+  StatePtr state_;
 };
 
 
@@ -126,9 +150,10 @@ class PromiseWithResolve : public Promise<T> {
 public:
   PromiseWithResolve() : Promise<T>::Promise() {}
 
-  template <typename T_ = T, typename = enable_if_not_void_t<T_>>
-  void Resolve(const T_& value) {
-    Promise<T>::State::Resolve(state_, value);
+  // Copies or moves the value into the promise.
+  template <typename U, typename T_ = T, typename = enable_if_not_void_t<T_>>
+  void Resolve(U&& value) {
+    Promise<T>::State::Resolve(state_, std::forward<U>(value));
   }
 
   template <typename T_ = T, typename = enable_if_is_void_t<T_>>
@@ -139,3 +164,78 @@ public:
 private:
   using Promise<T>::state_;
 };
+
+
+// Promise combinators. Like promises, without the heap: their state is kept
+// in promise pools (see promise_pool_capacity). Each registers the value
+// handlers of given promises. See also Scheduler::WithTimeout().
+class Promises {
+public:
+  // Returns a promise resolved, once all given promises are resolved, with
+  // a tuple of their values, in order. An empty struct stands for the value
+  // of a Promise<void> (see fix_void_t). Eg.
+  //   Promises::All(left.ReadDistance(), right.ReadDistance())
+  //     .ThenVoid([](std::tuple<Reading, Reading>&& readings) { ... });
+  //
+  // Costs static RAM per distinct Ts...: a pool of states holding the values
+  // received so far, of promise_pool_capacity<AllState<Ts...>> (2 by default,
+  // an All() of given types being seldom pending more than once at a time),
+  // on top of the pool of Promise<std::tuple<...>> states.
+  template <typename... Ts>
+  static Promise<std::tuple<fix_void_t<Ts>...>> All(Promise<Ts>... promises) {
+    static_assert(sizeof...(Ts) > 0, "No promises.");
+    using State = internal::promise::AllState<Ts...>;
+    const PromiseStatePtr<State> state = PromiseStatePtr<State>::Make(State());
+    ThenAll(state, std::index_sequence_for<Ts...>(), std::move(promises)...);
+    return state->value().result;
+  }
+
+  // Returns a promise resolved with the value of the first of given promises
+  // to be resolved. Values of the others are dropped.
+  template <typename T, typename... Ts>
+  static Promise<T> Any(Promise<T> promise, Promise<Ts>... promises) {
+    static_assert((std::is_same_v<T, Ts> && ...), "Promises of other types.");
+    PromiseWithResolve<T> result;
+    ThenAny(result, std::move(promise));
+    (ThenAny(result, std::move(promises)), ...);
+    return result;
+  }
+
+private:
+  template <typename State, size_t... is, typename... Ts>
+  static void ThenAll(const PromiseStatePtr<State>& state,
+                      std::index_sequence<is...>, Promise<Ts>... promises) {
+    (ThenSet<is>(state, std::move(promises)), ...);
+  }
+
+  template <size_t i, typename State, typename T>
+  static void ThenSet(const PromiseStatePtr<State>& state,
+                      Promise<T> promise) {
+    if constexpr (!std::is_void_v<T>) {
+      promise.ThenVoid([state](T&& value) {
+        state->value().template Set<i>(std::move(value));
+      });
+    } else {
+      promise.ThenVoid([state]() {
+        state->value().template Set<i>(fix_void_t<void>());
+      });
+    }
+  }
+
+  template <typename T>
+  static void ThenAny(PromiseWithResolve<T> result, Promise<T> promise) {
+    if constexpr (!std::is_void_v<T>) {
+      promise.ThenVoid([result](T&& value) mutable {
+        if (!result.is_resolved()) {
+          result.Resolve(std::move(value));
+        }
+      });
+    } else {
+      promise.ThenVoid([result]() mutable {
+        if (!result.is_resolved()) {
+          result.Resolve();
+        }
+      });
+    }
+  }
+};
@@ -0,0 +1,159 @@
+// Measures the cost of promise chains run by the scheduler, with value
+// handlers run via the executor or inline (see Promise::Inline()).
+//
+// Machine-readable output: BENCHMARK_FORMAT=json (see Benchmark).
+
+#include <cstdint>
+#include <cstdio>
+
+#include "os/ticks.h"
+
+
+#define TEST_CRITICAL_SECTION(code) code
+
+
+// Advances 1 usec per Now() call, so that simulated time is independent of
+// host speed and each policy runs the same task schedule.
+class FakeTimer {
+public:
+  TimePoint Now() { return TimePoint(now_++); }
+
+  TimePoint SleepUntil(TimePoint time) {
+    if (TimePoint(now_) < time) {
+      now_ = time.ticks();
+    }
+    return TimePoint(now_);
+  }
+
+private:
+  uint32_t now_ = 0;
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
+
+#include "lib/testing/benchmark.h"
+#include "os/scheduler.h"
+
+
+class TestScheduler : public Scheduler<const char, HeapTaskQueue, 16,
+                                       NoSchedulerStats> {};
+
+// Global Scheduler, for SchedulerExecutor::RunAsync().
+volatile TestScheduler scheduler_;
+#define TEST_SCHEDULER scheduler_  // Inject scheduler_ into code under test.
+#include "os/scheduler-global.h"
+#include "lib/promise.h"
+#include "os/scheduler-promise.h"
+
+
+// Host model of DistanceSensor's pipeline (see devices/distance_sensor.h),
+// whose pins need the board: a trigger pulse ended by a timer, the echo pin
+// going high then low, each event resolving a promise from a scheduler task,
+// and a chain of handlers turning the events into a reading, and starting the
+// next reading.
+class DistanceSensorPipeline {
+public:
+  struct Reading {
+    uint16_t distance_mm;
+    uint32_t time_usec;
+  };
+
+  DistanceSensorPipeline(Continuation continuation, uint32_t num_readings)
+    : continuation_(continuation), num_readings_(num_readings) {}
+
+  void ReadDistances() {
+    ReadDistance().ThenVoid([this](const Reading& reading) {
+      distance_mm_sum_ += reading.distance_mm;
+      if (++num_readings_read_ < num_readings_) {
+        ReadDistances();
+      } else {
+        scheduler_.Stop();
+      }
+    });
+  }
+
+private:
+  Promise<Reading> ReadDistance() {
+    Promise<void> pulse_ended = scheduler_.AfterMicros(10);
+    if (continuation_ == Continuation::INLINE) {
+      pulse_ended.Inline();
+    }
+    return pulse_ended.Then([this]() {
+      const uint32_t time_usec = timer_.Now().ToMicros();
+      return OnceSpikes().Then([time_usec](uint32_t spike_duration_usec) {
+        const uint16_t distance_mm = spike_duration_usec * 10 / 58;
+        return Reading{distance_mm, time_usec};
+      });
+    });
+  }
+
+  Promise<uint32_t> OnceSpikes() {
+    return OnceChanges(100).Then([this](uint32_t time_high_usec) {
+      return OnceChanges(600).Then([time_high_usec](uint32_t time_low_usec) {
+        return time_low_usec - time_high_usec;
+      });
+    });
+  }
+
+  // Resolved with the time of the echo pin's change, after given time.
+  Promise<uint32_t> OnceChanges(uint32_t micros) {
+    PromiseWithResolve<uint32_t> changed;
+    if (continuation_ == Continuation::INLINE) {
+      changed.Inline();
+    }
+    scheduler_.RunAfterMicros(micros, [changed]() mutable {
+      changed.Resolve(timer_.Now().ToMicros());
+    });
+    return changed;
+  }
+
+  const Continuation continuation_;
+  const uint32_t num_readings_;
+  uint32_t num_readings_read_ = 0;
+  uint32_t distance_mm_sum_ = 0;
+};
+
+
+// Readings of a DistanceSensorPipeline.
+void BenchmarkDistanceSensor(const char* policy, Continuation continuation) {
+  constexpr uint32_t NUM_READINGS = 20000;
+  DistanceSensorPipeline pipeline(continuation, NUM_READINGS);
+  pipeline.ReadDistances();
+  char name[64];
+  std::snprintf(name, sizeof(name), "distance_sensor/%s", policy);
+  Benchmark::Run(name, NUM_READINGS, []() { scheduler_.Loop(); });
+}
+
+
+// Chains of num_links handlers on an already resolved promise.
+void BenchmarkResolvedChain(const char* policy, Continuation continuation,
+                            uint8_t num_links) {
+  constexpr uint32_t NUM_CHAINS = 20000;
+  uint32_t sum = 0;
+  char name[64];
+  std::snprintf(name, sizeof(name), "resolved_chain/%s/%u", policy, num_links);
+  Benchmark::Run(name, NUM_CHAINS * num_links, [&]() {
+    for (uint32_t i = 0; i < NUM_CHAINS; ++i) {
+      Promise<uint32_t> chain = Promise<uint32_t>::Resolved(i);
+      if (continuation == Continuation::INLINE) {
+        chain.Inline();
+      }
+      for (uint8_t link = 1; link < num_links; ++link) {
+        chain = chain.Then([](uint32_t value) { return value + 1; });
+      }
+      chain.ThenVoid([&sum](uint32_t value) { sum += value; });
+      scheduler_.Loop();
+    }
+  });
+}
+
+
+int main() {
+  BenchmarkDistanceSensor("async", Continuation::ASYNC);
+  BenchmarkDistanceSensor("inline", Continuation::INLINE);
+  for (uint8_t num_links : {1, 4, 8}) {
+    BenchmarkResolvedChain("async", Continuation::ASYNC, num_links);
+    BenchmarkResolvedChain("inline", Continuation::INLINE, num_links);
+  }
+  return 0;
+}
@@ -1,9 +1,23 @@
 
 #include <cstdio>
 #include <memory>
+#include <tuple>
 
 #include "os/testing/sequential_executor.h"
 #include "lib/promise.h"
+#include "lib/testing/check_failure.h"
+
+
+// Counts its copies.
+struct Counted {
+  Counted(int id) : id(id) {}
+  Counted(const Counted& other) : id(other.id) { ++copies; }
+  Counted(Counted&& other) = default;
+
+  int id;
+
+  static inline int copies = 0;
+};
 
 
 int main() {
@@ -28,7 +42,7 @@ int main() {
   {
     int a = 0;
     PromiseWithResolve<int> p1;
-    p1.Then<int>([](int i) { return i + 1; })
+    p1.Then([](int i) { return i + 1; })
       .ThenVoid([&a](int i) { a = i; });
     executor_.Loop();
     assert(a == 0);
@@ -37,10 +51,21 @@ int main() {
     assert(a == 2);
   }
 
+  {
+    // The child promise's type is deduced from the handler.
+    float a = 0;
+    PromiseWithResolve<int> p1;
+    const Promise<float> child = p1.Then([](int i) { return i / 2.0f; });
+    Promise<float>(child).ThenVoid([&a](float f) { a = f; });
+    p1.Resolve(3);
+    executor_.Loop();
+    assert(a == 1.5f);
+  }
+
   {
     bool resolved = false;
     PromiseWithResolve<void> p1;
-    p1.Then<void>([]() { })
+    p1.Then([]() { })
       .ThenVoid([&resolved]() { resolved = true; });
     executor_.Loop();
     assert(!resolved);
@@ -52,7 +77,7 @@ int main() {
   {
     int a = 1;
     PromiseWithResolve<int> p1;
-    p1.Then<int>([](int i) {
+    p1.Then([](int i) {
       return Promise<int>::Resolved(i);
     }).ThenVoid([&a](int i) {
       a += i;
@@ -67,9 +92,7 @@ int main() {
   {
     bool resolved = false;
     PromiseWithResolve<void> p1;
-    // TODO: Remove static_cast.
-    p1.Then<void>(static_cast<std::function<Promise<void>()>>(
-      []() { return Promise<void>::Resolved(); }))
+    p1.Then([]() { return Promise<void>::Resolved(); })
       .ThenVoid([&resolved]() { resolved = true; });
     executor_.Loop();
     assert(!resolved);
@@ -82,7 +105,7 @@ int main() {
     int a = 1;
     PromiseWithResolve<int> p1;
     PromiseWithResolve<int> p2;
-    p1.Then<int>([&p2](int) {
+    p1.Then([&p2](int) {
       // TODO: Remove the 2 extra copy (?) constructor calls.
       return p2;
     }).ThenVoid([&a](int i) { a += i; });
@@ -100,13 +123,10 @@ int main() {
     bool resolved = false;
     PromiseWithResolve<void> p1;
     PromiseWithResolve<void> p2;
-    // TODO: Remove static_cast.
-    p1.Then<void>(static_cast<std::function<Promise<void>()>>(
-      [&p2]() {
-        // TODO: Remove the 2 extra copy (?) constructor calls.
-        return p2;
-      }))
-      .ThenVoid([&resolved]() { resolved = true; });
+    p1.Then([&p2]() {
+      // TODO: Remove the 2 extra copy (?) constructor calls.
+      return p2;
+    }).ThenVoid([&resolved]() { resolved = true; });
     executor_.Loop();
     assert(!resolved);
     p1.Resolve();
@@ -141,7 +161,7 @@ int main() {
     int i = 1; int *ip = &i;
     auto promise = std::make_unique<PromiseWithResolve<void>>();
     promise
-      ->Then<void>([&promise]() { promise.reset(); })
+      ->Then([&promise]() { promise.reset(); })
       .ThenVoid([ip]() { assert(ip); *ip = 2; });
     promise->Resolve();
     executor_.Loop();
@@ -150,9 +170,179 @@ int main() {
 
   {
     int a = 0;
-    Promise<int>::Resolved(1).Then<void>([&a](int i) { a = i; });
+    Promise<int>::Resolved(1).Then([&a](int i) { a = i; });
+    executor_.Loop();
+    assert(a == 1);
+  }
+
+  {
+    // Inline handlers: run when resolved, without the executor.
+    int a = 0;
+    PromiseWithResolve<int> p1;
+    PromiseWithResolve<int> p2;
+    p1.Inline()
+      .Then([](int i) { return i + 1; })
+      .Then([&p2](int) { return p2; })
+      .ThenVoid([&a](int i) { a = i; });
+    p1.Resolve(1);
+    assert(a == 0);
+    p2.Resolve(3);
+    assert(a == 3);
+    Promise<int>::Resolved(2).Inline().ThenVoid([&a](int i) { a = i; });
+    assert(a == 2);
+  }
+
+  {
+    // Inline handlers nest up to MAX_INLINE_CONTINUATION_DEPTH, then are run
+    // by the executor.
+    int calls = 0;
+    PromiseWithResolve<void> p;
+    Promise<void> chain = p;
+    chain.Inline();
+    for (int i = 0; i < MAX_INLINE_CONTINUATION_DEPTH + 2; ++i) {
+      chain = chain.Then([&calls]() { ++calls; });
+    }
+    p.Resolve();
+    assert(calls == MAX_INLINE_CONTINUATION_DEPTH);
+    executor_.Loop();
+    assert(calls == MAX_INLINE_CONTINUATION_DEPTH + 2);
+  }
+
+  {
+    // Not run inline from interrupt handlers.
+    bool resolved = false;
+    PromiseWithResolve<void> p;
+    p.Inline().ThenVoid([&resolved]() { resolved = true; });
+    {
+      Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+      p.Resolve();
+    }
+    assert(!resolved);
+    executor_.Loop();
+    assert(resolved);
+  }
+
+  {
+    // Move-only values.
+    int a = 0;
+    PromiseWithResolve<std::unique_ptr<int>> p;
+    p.Then([](std::unique_ptr<int> i) { ++*i; return i; })
+      .ThenVoid([&a](std::unique_ptr<int>&& i) { a = *i; });
+    p.Resolve(std::make_unique<int>(1));
+    executor_.Loop();
+    assert(a == 2);
+  }
+
+  {
+    // The value is moved into the one handler: a further handler, which would
+    // get a moved-from value, fails a CHECK.
+    int a = 0;
+    PromiseWithResolve<std::unique_ptr<int>> p;
+    p.ThenVoid([&a](std::unique_ptr<int>&& i) { a = *i; });
+    p.Resolve(std::make_unique<int>(1));
     executor_.Loop();
     assert(a == 1);
+    assert(FailsCheck([&p]() {
+      p.ThenVoid([](std::unique_ptr<int>&&) {});
+    }));
+    assert(FailsCheck([&p]() {
+      p.Then([](std::unique_ptr<int>&& i) { return *i; });
+    }));
+  }
+
+  {
+    // Values are moved along a chain, not copied: from Resolve(), through
+    // handlers returning them, and via nested promises.
+    Counted::copies = 0;
+    int id = 0;
+    PromiseWithResolve<Counted> p;
+    p.Then([](Counted c) { return c; })
+      .Then([](Counted&& c) {
+        return Promise<Counted>::Resolved(std::move(c));
+      })
+      .Inline()
+      .ThenVoid([&id](const Counted& c) { id = c.id; });
+    p.Resolve(Counted(1));
+    executor_.Loop();
+    assert(id == 1);
+    assert(Counted::copies == 0);
+  }
+
+  {
+    // All: resolved with all values, once the last promise is resolved.
+    std::tuple<int, fix_void_t<void>, std::unique_ptr<int>> all;
+    bool resolved = false;
+    PromiseWithResolve<int> p1;
+    PromiseWithResolve<void> p2;
+    PromiseWithResolve<std::unique_ptr<int>> p3;
+    Promises::All(p1, p2, p3).ThenVoid([&](auto&& values) {
+      all = std::move(values);
+      resolved = true;
+    });
+    p3.Resolve(std::make_unique<int>(3));
+    p1.Resolve(1);
+    executor_.Loop();
+    assert(!resolved);
+    p2.Resolve();
+    executor_.Loop();
+    assert(resolved);
+    assert(std::get<0>(all) == 1 && *std::get<2>(all) == 3);
+    // Its state is released, back to a small pool of its own.
+    using State = internal::promise::AllState<int, void, std::unique_ptr<int>>;
+    assert(promise_state_pool<State>.size() == 0);
+    static_assert(promise_pool_capacity<State> == 2);
+  }
+
+  {
+    // Any: resolved with the first value.
+    int first = 0;
+    PromiseWithResolve<int> p1;
+    PromiseWithResolve<int> p2;
+    Promises::Any(p1, p2).ThenVoid([&first](int i) { first = i; });
+    p2.Resolve(2);
+    executor_.Loop();
+    assert(first == 2);
+    p1.Resolve(1);
+    executor_.Loop();
+    assert(first == 2);
+
+    bool resolved = false;
+    PromiseWithResolve<void> p3;
+    Promises::Any(p3, Promise<void>::Resolved())
+      .ThenVoid([&resolved]() { resolved = true; });
+    executor_.Loop();
+    assert(resolved);
+  }
+
+  // All states above have been returned to their pools.
+  assert(Promise<int>::pool().size() == 0);
+  assert(Promise<void>::pool().size() == 0);
+
+  {
+    // A state is shared by copies of a promise and by a pending handler, and
+    // returned to its pool with the last of these.
+    PromiseWithResolve<int> p;
+    {
+      const Promise<int> copy = p;
+      assert(Promise<int>::pool().size() == 1);
+    }
+    {
+      const Promise<void> child = p.Then([](int) {});
+      assert(Promise<void>::pool().size() == 1);
+    }
+    assert(Promise<void>::pool().size() == 1);  // Held by p's handler.
+    p.Resolve(1);
+    executor_.Loop();
+    // Released with the handler once it is run.
+    assert(Promise<void>::pool().size() == 0);
+  }
+  assert(Promise<int>::pool().size() == 0);
+  assert(Promise<void>::pool().size() == 0);
+
+  {
+    // The high-water mark, to size pools.
+    PromiseWithResolve<int> p[5];
+    assert(Promise<int>::pool().high_water_mark() == 5);
   }
 
   return 0;
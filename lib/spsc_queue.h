@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+
+// Fixed-capacity FIFO queue for a single producer and a single consumer
+// running concurrently, eg. an interrupt handler and the main thread.
+//
+// Lock-free: neither side blocks the other or disables interrupts. Each side
+// owns one 8-bit index - the producer tail_, the consumer head_ - and
+// publishes its progress with a single atomic store of it. The indices run
+// freely, wrapping around at 256, hence capacity must be a power of 2.
+//
+// push() may only be called by the producer, pop() by the consumer. empty()
+// and size() may be called by either, but are exact only for the consumer.
+template <typename T, uint8_t capacity>
+class SpscQueue {
+  static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0
+                && capacity <= 128, "Capacity must be a power of 2 <= 128.");
+
+public:
+  bool empty() const { return size() == 0; }
+
+  uint8_t size() const {
+    return Load(tail_) - Load(head_);
+  }
+
+  // Producer. Returns false if the queue is full.
+  bool push(const T& t) {
+    const uint8_t tail = tail_;  // Only written by this side.
+    if (static_cast<uint8_t>(tail - Load(head_)) == capacity) {
+      return false;
+    }
+    buffer_[tail & MASK] = t;
+    Store(tail_, tail + 1);  // Publishes the element.
+    return true;
+  }
+
+  // Consumer. Returns false if the queue is empty.
+  bool pop(T* t) {
+    const uint8_t head = head_;  // Only written by this side.
+    if (head == Load(tail_)) {
+      return false;
+    }
+    *t = buffer_[head & MASK];
+    Store(head_, head + 1);  // Releases the element's storage.
+    return true;
+  }
+
+private:
+  static constexpr uint8_t MASK = capacity - 1;
+
+  // Single-byte atomic accesses. Plain loads and stores on AVR, ordered
+  // with respect to accesses to buffer_ (acquire / release).
+  static uint8_t Load(const uint8_t& index) {
+    return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+  }
+
+  static void Store(uint8_t& index, uint8_t value) {
+    __atomic_store_n(&index, value, __ATOMIC_RELEASE);
+  }
+
+  std::array<T, capacity> buffer_;
+  uint8_t head_ = 0;  // Written by the consumer.
+  uint8_t tail_ = 0;  // Written by the producer.
+};
@@ -0,0 +1,76 @@
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+#include "lib/spsc_queue.h"
+
+using namespace std;
+
+
+int main() {
+  {
+    SpscQueue<int, 4> queue;
+    int i;
+    assert(queue.empty());
+    assert(!queue.pop(&i));
+
+    assert(queue.push(1));
+    assert(queue.push(2));
+    assert(queue.size() == 2);
+    assert(queue.pop(&i) && i == 1);
+    assert(queue.push(3));
+    assert(queue.push(4));
+    assert(queue.push(5));
+    assert(!queue.push(6));  // Full.
+    assert(queue.size() == 4);
+    assert(queue.pop(&i) && i == 2);
+    assert(queue.pop(&i) && i == 3);
+    assert(queue.pop(&i) && i == 4);
+    assert(queue.pop(&i) && i == 5);
+    assert(queue.empty());
+  }
+
+  {
+    // Indices wrap around at 256.
+    SpscQueue<uint32_t, 8> queue;
+    uint32_t value;
+    for (uint32_t i = 0; i < 1000; ++i) {
+      assert(queue.push(i));
+      assert(queue.pop(&value) && value == i);
+    }
+  }
+
+  {
+    // Stress: a producer thread (a simulated interrupt handler) and
+    // the consumer run concurrently. All elements arrive, in order, even
+    // though the queue is often full or empty.
+    constexpr uint32_t NUM_ELEMENTS = 100000;
+    struct Element {
+      uint32_t value;
+      uint32_t check;  // Detects torn (partially published) elements.
+    };
+    SpscQueue<Element, 8> queue;
+    thread producer([&]() {
+      for (uint32_t i = 0; i < NUM_ELEMENTS; ++i) {
+        while (!queue.push({i, ~i})) {
+          this_thread::yield();
+        }
+      }
+    });
+    uint32_t expected = 0;
+    Element element;
+    while (expected < NUM_ELEMENTS) {
+      if (queue.pop(&element)) {
+        assert(element.value == expected);
+        assert(element.check == ~expected);
+        ++expected;
+      } else {
+        this_thread::yield();
+      }
+    }
+    producer.join();
+    assert(queue.empty());
+  }
+
+  return 0;
+}
@@ -0,0 +1,46 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+
+// Counts heap allocations made by code under test, by replacing the global
+// operator new / delete. Include from a test's .cc file only (the replacement
+// operators are defined here and can not be inline).
+//
+// eg.
+//   AllocationCounter allocations;
+//   CodeUnderTest();
+//   assert(allocations.count() == 0);
+class AllocationCounter {
+public:
+  AllocationCounter() : count_at_start_(total_count_) {}
+
+  // Number of allocations since this instance was created.
+  size_t count() const { return total_count_ - count_at_start_; }
+
+  static void Increment() { ++total_count_; }
+
+private:
+  const size_t count_at_start_;
+  static inline size_t total_count_ = 0;
+};
+
+
+void* operator new(size_t size) {
+  AllocationCounter::Increment();
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
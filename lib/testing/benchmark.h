@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lib/testing/allocation_counter.h"
+
+
+// Minimal harness for host (development environment) microbenchmarks.
+// Include from a benchmark's .cc file only (see AllocationCounter).
+//
+// Prints a result per benchmark: average wall time and number of heap
+// allocations per operation. Human-readable by default or, if environment
+// variable BENCHMARK_FORMAT=json, one JSON object per line - to be collected
+// and compared across code changes, eg.
+//   BENCHMARK_FORMAT=json build/benchmark.sh > results.jsonl
+class Benchmark {
+public:
+  // Runs f, that performs num_ops operations of the benchmarked kind,
+  // and prints the average wall time and allocations per operation.
+  // Excludes the scopes of Untimed instances in f.
+  template <typename F>
+  static void Run(const char* name, uint32_t num_ops, F&& f) {
+    excluded_ns_ = 0;
+    excluded_allocations_ = 0;
+    const AllocationCounter allocations;
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    const double ns =
+      std::chrono::duration<double, std::nano>(end - start).count()
+      - excluded_ns_;
+    const double num_allocations =
+      allocations.count() - excluded_allocations_;
+    Print(name, num_ops, ns / num_ops, num_allocations / num_ops);
+  }
+
+  // Excludes its scope from the result of the enclosing Run(), eg. setup or
+  // cleanup between rounds of benchmarked operations.
+  class Untimed {
+  public:
+    Untimed() : start_(std::chrono::steady_clock::now()) {}
+
+    ~Untimed() {
+      excluded_ns_ += std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start_).count();
+      excluded_allocations_ += allocations_.count();
+    }
+
+  private:
+    const std::chrono::steady_clock::time_point start_;
+    const AllocationCounter allocations_;
+  };
+
+private:
+  static void Print(const char* name, uint32_t num_ops,
+                    double ns_per_op, double allocations_per_op) {
+    const char* const format = std::getenv("BENCHMARK_FORMAT");
+    if (format && std::strcmp(format, "json") == 0) {
+      std::printf("{\"name\": \"%s\", \"ops\": %u, \"ns_per_op\": %.1f, "
+                  "\"allocations_per_op\": %.3f}\n",
+                  name, num_ops, ns_per_op, allocations_per_op);
+    } else {
+      std::printf("%-48s %10.1f ns/op %8.3f allocs/op\n",
+                  name, ns_per_op, allocations_per_op);
+    }
+  }
+
+  static inline double excluded_ns_ = 0;
+  static inline size_t excluded_allocations_ = 0;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Whether given code fails a CHECK: runs it in a forked child process, where
+// a failed CHECK (an assert on Linux, see lib/check.h) aborts the child only.
+// The child's stderr is discarded. Requires a build without NDEBUG.
+//
+// eg.
+//   assert(FailsCheck([&]() { CodeUnderTest(); }));
+template <typename F>
+bool FailsCheck(F&& f) {
+  const pid_t pid = fork();
+  if (pid == 0) {
+    const int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDERR_FILENO);
+    f();
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
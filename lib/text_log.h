@@ -32,7 +32,8 @@ struct TextFormat {
   template <typename StreamT, typename... Ts>
   static void WriteToStream(const Message<Ts...>& message) {
     TextStream<StreamT>::Write(message.header.severity);
-    TextStream<StreamT>::WriteMicros(message.header.micros);
+    TextStream<StreamT>::WriteMicros(
+      TimePoint(message.header.ticks).ToMicros());
     TextStream<StreamT>::WriteThread(message.header.thread_id);
     StreamT::Write(' ');
     TextStream<StreamT>::Write(message.header.file_name);
@@ -0,0 +1,213 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "lib/check.h"
+
+
+// Hierarchical timing wheel. A queue of nodes - small integer indices
+// 0..capacity-1, eg. of slots in an external fixed-size array - keyed on expiry
+// time, in ticks, that yields the nodes once their time has passed.
+// Compared to a heap:
+//   * Insert() and Remove() are O(1), regardless of the number of nodes,
+//   * expiry is amortized O(1): Advance() does a constant amount of work per
+//     elapsed tick, plus moving each node down the wheel levels at most
+//     `levels` times.
+// Nodes expiring in the same tick are yielded in unspecified order.
+//
+// The wheel has `levels` levels of 2^slot_bits slots each. A slot at level l
+// holds nodes expiring within 2^(slot_bits * l) ticks after the slot's start.
+// Nodes expiring beyond the range of the top level are kept in an overflow
+// list, re-examined each time the top level wraps around.
+//
+// Each inserted node is linked into a single doubly-linked list: a wheel slot,
+// the overflow list or the list of expired nodes. Lists are circular, with
+// a sentinel node each, so that linking and unlinking a node does not depend
+// on which list it is in.
+//
+// See "Hashed and Hierarchical Timing Wheels", Varghese & Lauck.
+template <uint8_t capacity, uint8_t slot_bits = 4, uint8_t levels = 3>
+class TimingWheel {
+  static constexpr uint8_t SLOTS_PER_LEVEL = 1 << slot_bits;
+  static constexpr uint8_t SLOT_MASK = SLOTS_PER_LEVEL - 1;
+  static constexpr uint8_t NUM_SLOTS = levels * SLOTS_PER_LEVEL;
+
+  // Sentinel nodes of the lists, following the inserted nodes.
+  static constexpr uint8_t SLOT_LISTS = capacity;
+  static constexpr uint8_t OVERFLOW_LIST = SLOT_LISTS + NUM_SLOTS;
+  static constexpr uint8_t EXPIRED_LIST = OVERFLOW_LIST + 1;
+  static constexpr uint8_t NUM_NODES = EXPIRED_LIST + 1;
+
+public:
+  using Node = uint8_t;
+  static constexpr Node NONE = 0xFF;
+
+  static_assert(NUM_NODES < NONE, "Too many nodes for 8-bit node handles.");
+  static_assert(slot_bits * levels < 32, "Wheel range exceeds 32-bit ticks.");
+
+  TimingWheel() {
+    for (Node list = SLOT_LISTS; list < NUM_NODES; ++list) {
+      links_[list] = {list, list};
+    }
+    for (Node node = 0; node < capacity; ++node) {
+      links_[node] = {NONE, NONE};
+    }
+  }
+
+  bool empty() const { return size_ == 0; }
+  uint8_t size() const { return size_; }
+  bool contains(Node node) const { return links_[node].prev != NONE; }
+  uint32_t tick(Node node) const { return ticks_[node]; }
+
+  // Inserts a node expiring at given tick. A node whose tick has already
+  // passed is expired immediately.
+  void Insert(Node node, uint32_t tick) {
+    CHECK(node < capacity && !contains(node));
+    ticks_[node] = tick;
+    ++size_;
+    Link(node);
+  }
+
+  void Remove(Node node) {
+    CHECK(node < capacity && contains(node));
+    Unlink(node);
+    links_[node] = {NONE, NONE};
+    --size_;
+  }
+
+  // Advances the wheel to given tick and, if any node has expired, removes
+  // the earliest expired node and returns it. Otherwise returns NONE.
+  Node PopExpired(uint32_t now_tick) {
+    const Node node = PeekExpired(now_tick);
+    if (node != NONE) {
+      Remove(node);
+    }
+    return node;
+  }
+
+  // Like PopExpired(), but leaves the node in the wheel (first in line
+  // to be popped, unless removed or re-inserted).
+  Node PeekExpired(uint32_t now_tick) {
+    Advance(now_tick);
+    const Node node = links_[EXPIRED_LIST].next;
+    return node != EXPIRED_LIST ? node : NONE;
+  }
+
+  // Lower bound on the earliest tick of the nodes in the wheel, not before
+  // the current tick: exact if a node expires within the range of level 0,
+  // otherwise the next tick at which higher levels are cascaded down.
+  // O(2^slot_bits). Requires !empty().
+  uint32_t NextTick() const {
+    CHECK(!empty());
+    if (links_[EXPIRED_LIST].next != EXPIRED_LIST) {
+      return current_;
+    }
+    for (uint32_t tick = current_ + 1; tick <= current_ + RangeMask(1);
+         ++tick) {
+      const Node slot = Slot(0, tick);
+      if (links_[slot].next != slot) {
+        return tick;
+      }
+    }
+    return (current_ | RangeMask(1)) + 1;
+  }
+
+  // Advances the wheel's current tick to given tick, expiring nodes on the
+  // way. A no-op if the tick is not after the current tick. O(1) per tick.
+  void Advance(uint32_t now_tick) {
+    if (empty()) {
+      current_ = now_tick;  // Nothing to expire, skip the elapsed ticks.
+      return;
+    }
+    while (static_cast<int32_t>(now_tick - current_) > 0) {
+      ++current_;
+      if ((current_ & RangeMask(levels)) == 0) {
+        Cascade(OVERFLOW_LIST);
+      }
+      for (uint8_t level = levels - 1; level > 0; --level) {
+        if ((current_ & RangeMask(level)) == 0) {
+          Cascade(Slot(level, current_));
+        }
+      }
+      Splice(Slot(0, current_), EXPIRED_LIST);
+    }
+  }
+
+private:
+  struct Link_ {
+    Node next;
+    Node prev;
+  };
+
+  // Mask of the ticks covered by one slot of given level.
+  static constexpr uint32_t RangeMask(uint8_t level) {
+    return (uint32_t(1) << (slot_bits * level)) - 1;
+  }
+
+  static Node Slot(uint8_t level, uint32_t tick) {
+    return SLOT_LISTS + level * SLOTS_PER_LEVEL
+      + ((tick >> (slot_bits * level)) & SLOT_MASK);
+  }
+
+  // Links a node into the list matching its tick, relative to current tick.
+  void Link(Node node) {
+    const int32_t delta = static_cast<int32_t>(ticks_[node] - current_);
+    if (delta <= 0) {
+      Append(EXPIRED_LIST, node);
+      return;
+    }
+    for (uint8_t level = 0; level < levels; ++level) {
+      if (static_cast<uint32_t>(delta) <= RangeMask(level + 1)) {
+        Append(Slot(level, ticks_[node]), node);
+        return;
+      }
+    }
+    Append(OVERFLOW_LIST, node);
+  }
+
+  // Re-links all nodes of a list, moving them down the wheel levels.
+  void Cascade(Node list) {
+    Node node = links_[list].next;
+    links_[list] = {list, list};
+    while (node != list) {
+      const Node next = links_[node].next;
+      Link(node);
+      node = next;
+    }
+  }
+
+  void Append(Node list, Node node) {
+    const Node last = links_[list].prev;
+    links_[node] = {list, last};
+    links_[last].next = node;
+    links_[list].prev = node;
+  }
+
+  void Unlink(Node node) {
+    const Link_ link = links_[node];
+    links_[link.prev].next = link.next;
+    links_[link.next].prev = link.prev;
+  }
+
+  // Moves all nodes of list from to the end of list to.
+  void Splice(Node from, Node to) {
+    const Node first = links_[from].next;
+    if (first == from) {
+      return;
+    }
+    const Node last = links_[from].prev;
+    links_[from] = {from, from};
+    links_[links_[to].prev].next = first;
+    links_[first].prev = links_[to].prev;
+    links_[last].next = to;
+    links_[to].prev = last;
+  }
+
+  std::array<uint32_t, capacity> ticks_;
+  std::array<Link_, NUM_NODES> links_;
+  uint8_t size_ = 0;
+  uint32_t current_ = 0;
+};
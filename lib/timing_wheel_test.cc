@@ -0,0 +1,125 @@
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "lib/timing_wheel.h"
+
+using namespace std;
+
+
+template <typename WheelT>
+vector<int> PopAllExpired(WheelT* wheel, uint32_t now_tick) {
+  vector<int> nodes;
+  uint8_t node;
+  while ((node = wheel->PopExpired(now_tick)) != WheelT::NONE) {
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+
+int main() {
+  {
+    TimingWheel<8> wheel;
+    assert(wheel.empty());
+    wheel.Insert(3, 3);
+    wheel.Insert(1, 1);
+    wheel.Insert(2, 2);
+    assert(wheel.size() == 3);
+    assert(wheel.contains(2));
+    assert(!wheel.contains(0));
+    assert(PopAllExpired(&wheel, 0).empty());
+    assert(PopAllExpired(&wheel, 1) == vector<int>({1}));
+    assert(PopAllExpired(&wheel, 3) == vector<int>({2, 3}));
+    assert(wheel.empty());
+  }
+
+  {
+    // Nodes at all levels and in overflow (range: 2^(2*3) = 64 ticks).
+    TimingWheel<8, 2, 3> wheel;
+    const uint32_t ticks[] = {1000, 5, 63, 64, 65, 17, 200, 4};
+    for (uint8_t node = 0; node < 8; ++node) {
+      wheel.Insert(node, ticks[node]);
+    }
+    vector<int> expired;
+    for (uint32_t now = 0; now <= 1000; ++now) {
+      for (int node : PopAllExpired(&wheel, now)) {
+        assert(ticks[node] == now);  // Expires exactly at its tick.
+        expired.push_back(node);
+      }
+    }
+    assert(expired == vector<int>({7, 1, 5, 2, 3, 4, 6, 0}));
+    assert(wheel.empty());
+  }
+
+  {
+    // Advancing by many ticks at once.
+    TimingWheel<4, 2, 3> wheel;
+    wheel.Insert(0, 10);
+    wheel.Insert(1, 100);
+    wheel.Insert(2, 30);
+    wheel.Insert(3, 70);
+    assert(PopAllExpired(&wheel, 50) == vector<int>({0, 2}));
+    assert(PopAllExpired(&wheel, 150) == vector<int>({3, 1}));
+  }
+
+  {
+    // Nodes with past ticks expire immediately.
+    TimingWheel<4> wheel;
+    wheel.Advance(100);
+    wheel.Insert(0, 50);
+    wheel.Insert(1, 101);
+    assert(PopAllExpired(&wheel, 100) == vector<int>({0}));
+    assert(PopAllExpired(&wheel, 101) == vector<int>({1}));
+  }
+
+  {
+    // NextTick(): exact within level 0, otherwise a lower bound that is
+    // never after the earliest tick.
+    TimingWheel<4, 2, 3> wheel;
+    wheel.Insert(0, 2);
+    assert(wheel.NextTick() == 2);
+    wheel.Insert(1, 1);
+    assert(wheel.NextTick() == 1);
+    wheel.Remove(0);
+    wheel.Remove(1);
+    wheel.Insert(2, 40);
+    uint32_t now = 0;
+    while (PopAllExpired(&wheel, now).empty()) {
+      assert(wheel.NextTick() > now && wheel.NextTick() <= 40);
+      now = wheel.NextTick();
+    }
+    assert(now == 40);
+    wheel.Insert(3, 30);
+    assert(wheel.NextTick() == 40);  // Expired.
+  }
+
+  {
+    // Removal, and reinsertion of removed nodes.
+    TimingWheel<4> wheel;
+    wheel.Insert(0, 10);
+    wheel.Insert(1, 20);
+    wheel.Insert(2, 30);
+    wheel.Remove(0);
+    wheel.Remove(2);
+    assert(wheel.size() == 1);
+    assert(PopAllExpired(&wheel, 100) == vector<int>({1}));
+    wheel.Insert(2, 200);
+    wheel.Insert(0, 300);
+    assert(PopAllExpired(&wheel, 300) == vector<int>({2, 0}));
+  }
+
+  {
+    // Ticks wrapping around 2^32.
+    TimingWheel<4> wheel;
+    wheel.Advance(0xFFFFFFF0);
+    wheel.Insert(1, 0xFFFFFFF8);
+    wheel.Insert(2, 0x00000008);
+    assert(PopAllExpired(&wheel, 0xFFFFFFFF) == vector<int>({1}));
+    assert(PopAllExpired(&wheel, 0x00000007).empty());
+    assert(PopAllExpired(&wheel, 0x00000008) == vector<int>({2}));
+  }
+
+  return 0;
+}
@@ -7,8 +7,13 @@ enum class PinMode : uint8_t;
 
 #ifndef TEST_ARDUINO
 
+#include <avr/interrupt.h>  // TODO: Wrap in arduino-core/*.
+#include <avr/sleep.h>  // TODO: Wrap in arduino-core/*.
+
 #include "arduino-core/wiring.h"
 
+extern "C" volatile unsigned long timer0_overflow_count;  // wiring.c
+
 // Arduino hardware abstraction layer (HAL). Interface to on-board hardware.
 //
 // Implemented as a thin wrapper around <Arduino core library>/Arduino.h
@@ -39,6 +44,59 @@ public:
   static uint32_t GetMicrosecondsSinceStart() {
     return ::micros();
   }
+
+  // Timer0 ticks (4 usec) since start: micros() without the conversion
+  // to usec. Wraps around every 2^32 ticks.
+  static uint32_t GetTicksSinceStart() {
+    const uint8_t sreg = SREG;
+    cli();
+    uint32_t overflows = timer0_overflow_count;
+    const uint8_t ticks = TCNT0;
+    if ((TIFR0 & _BV(TOV0)) && ticks < 255) {  // Overflow not yet counted.
+      ++overflows;
+    }
+    SREG = sreg;
+    return (overflows << 8) | ticks;
+  }
+
+  // Puts the MCU to sleep until the next interrupt. Idle sleep mode: timers
+  // keep running, and so does the timer behind GetMicrosecondsSinceStart().
+  // To be called with interrupts disabled. Enables them atomically with
+  // going to sleep, so that an interrupt that has just arrived is not missed
+  // - it wakes the MCU right away.
+  static void SleepUntilInterrupt() {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sei();
+    sleep_cpu();  // Executed before any interrupt pending at sei().
+    sleep_disable();
+  }
+
+  // Timer1, 16-bit, free-running (normal mode) at 2 MHz (prescaler 8): ticks
+  // of 0.5 usec, wrapping every 32768 usec. Takes Timer1 over from the Arduino
+  // core (PWM on pins 9 and 10). To be called after init() (wiring.c).
+  static void StartCompareTimer() {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11);
+    TIMSK1 = 0;
+  }
+
+  // To be called with interrupts disabled: a 16-bit register read.
+  static uint16_t GetCompareTimerTicks() {
+    return TCNT1;
+  }
+
+  // Raises interrupt TIMER1_COMPA_vect when Timer1 reaches given ticks.
+  // To be called with interrupts disabled.
+  static void SetCompareMatch(uint16_t ticks) {
+    OCR1A = ticks;
+    TIFR1 = _BV(OCF1A);  // Clear a match pending from before.
+    TIMSK1 |= _BV(OCIE1A);
+  }
+
+  static void ClearCompareMatch() {
+    TIMSK1 &= ~_BV(OCIE1A);
+  }
 };
 
 #else
@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef TEST_COMPARE_MATCH_LANE
+#include <avr/interrupt.h>  // TODO: Wrap in arduino-core/*, os/arduino.h.
+
+#include "os/compare_match_lane.h"
+#include "os/thread.h"
+
+inline volatile CompareMatchLane compare_match_lane;  // Global instance.
+
+ISR(TIMER1_COMPA_vect) {
+  Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+  compare_match_lane.HandleCompareMatch();
+}
+#else
+volatile auto& compare_match_lane = TEST_COMPARE_MATCH_LANE;  // Injected.
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "arduino-ext/critical_section.h"
+#include "lib/check.h"
+#include "lib/inline_function.h"
+#include "lib/promise.h"
+#include "os/compare_timer-global.h"
+#include "os/scheduler-global.h"
+
+
+// Hard real-time lane: runs tiny callables directly from the compare-match
+// interrupt handler of the CompareTimer, on time to within the interrupt
+// latency (a few usec) however busy the Scheduler's loop is. Eg. to end
+// a pulse of a precise width on a pin.
+//
+// A callable run from the interrupt handler must be short and interrupt-safe,
+// eg. set a pin. Its completion is posted back to the Scheduler: the promise
+// returned by RunAfterMicros() is resolved by an async task (see
+// Scheduler::RunAsync()), so that the work that follows runs in the main
+// thread. If the Scheduler drops that task (is full), the interrupt handler
+// posts it again every RETRY_TICKS until the Scheduler takes it.
+//
+// Up to MAX_CALLABLES may be pending at a time. The compare timer is armed for
+// the earliest of them.
+//
+// To be driven by HandleCompareMatch(), from the interrupt handler, see
+// os/compare_match_lane-global.h.
+class CompareMatchLane {
+public:
+  static constexpr uint8_t MAX_CALLABLES = 4;
+
+  // Half of the compare timer's range: due ticks are compared wrap-safe.
+  static constexpr uint16_t MAX_MICROS = 16000;
+
+  // A callable is never run earlier than this many ticks after the compare
+  // timer is armed for it, so that the timer does not pass it before being
+  // armed. Arming takes about 25 cycles from reading the counter to clearing
+  // a stale match (see ArmEarliest(), Arduino::SetCompareMatch()), ie. about
+  // 3 ticks at 8 cycles per tick: twice that, for margin. Should it still be
+  // passed, eg. in a slower build, ArmEarliest() arms again further ahead.
+  static constexpr uint8_t MIN_LEAD_TICKS = 8;
+
+  // Interval at which a completion dropped by the Scheduler is posted again.
+  static constexpr uint16_t RETRY_TICKS = 1000;
+
+  // Run from the interrupt handler.
+  using IsrCallable = InlineFunction<void(), 2 * sizeof(void*)>;
+
+  // Starts the compare timer. To be called once, at setup.
+  void Start() volatile {
+    CRITICAL_SECTION({
+      compare_timer.Start();
+    });
+  }
+
+  // Runs given callable from the compare-match interrupt handler, after given
+  // number of microseconds. Returns a promise resolved, in the main thread,
+  // after the callable has run. To be called from the main thread.
+  Promise<void> RunAfterMicros(uint16_t micros,
+                               IsrCallable&& callable) volatile {
+    CHECK(micros <= MAX_MICROS);
+    CompareMatchLane* const this_ = this_nv();
+    // Only the main thread frees entries, so a free one stays free.
+    uint8_t i = 0;
+    while (i < MAX_CALLABLES && this_->entries_[i].state != Entry::FREE) {
+      ++i;
+    }
+    CHECK(i < MAX_CALLABLES);  // Else increase MAX_CALLABLES.
+    Entry& entry = this_->entries_[i];
+    entry.callable = std::move(callable);
+    entry.completed.emplace();
+    const Promise<void> completed = *entry.completed;
+    CRITICAL_SECTION({
+      entry.due_ticks =
+        compare_timer.NowTicks() + micros * compare_timer.TICKS_PER_MICRO;
+      entry.state = Entry::ARMED;
+      this_nv()->ArmEarliest();
+    });
+    return completed;
+  }
+
+  // Runs the callables that are due and rearms the compare timer. To be
+  // called from the compare-match interrupt handler.
+  void HandleCompareMatch() volatile {
+    CompareMatchLane* const this_ = this_nv();
+    const uint16_t now = compare_timer.NowTicks();
+    for (Entry& entry : this_->entries_) {
+      if (entry.state == Entry::ARMED && TicksUntil(entry, now) <= 0) {
+        entry.callable();
+        entry.state = Entry::UNPOSTED;
+      }
+      if (entry.state == Entry::UNPOSTED) {
+        this_->PostCompletion(entry);
+      }
+    }
+    this_->ArmEarliest();
+  }
+
+private:
+  struct Entry {
+    enum State : uint8_t {
+      FREE,
+      ARMED,     // To be run by HandleCompareMatch().
+      UNPOSTED,  // Run, completion dropped by the Scheduler: to be reposted.
+      FIRED,     // Run, to be completed by the main thread.
+    };
+
+    uint16_t due_ticks = 0;
+    IsrCallable callable;
+    std::optional<PromiseWithResolve<void>> completed;
+    State state = FREE;
+  };
+
+  static int16_t TicksUntil(const Entry& entry, uint16_t now) {
+    return static_cast<int16_t>(entry.due_ticks - now);
+  }
+
+  // Posts the completion of an UNPOSTED entry to the Scheduler. The entry
+  // stays UNPOSTED if the Scheduler drops it. Called with interrupts disabled.
+  void PostCompletion(Entry& entry) {
+    const auto task_id = scheduler.RunAsync(
+      [this, &entry]() { Complete(entry); }, P("Complete() CompareMatchLane"));
+    if (task_id != scheduler.NO_TASK) {
+      entry.state = Entry::FIRED;
+    }
+  }
+
+  // Arms the compare timer for the earliest armed callable, at least
+  // MIN_LEAD_TICKS ahead, or RETRY_TICKS ahead at the latest if a completion
+  // is to be reposted. Disarms it if there is neither. Called with interrupts
+  // disabled.
+  void ArmEarliest() {
+    const Entry* earliest = nullptr;
+    bool unposted = false;
+    for (const Entry& entry : entries_) {
+      if (entry.state == Entry::UNPOSTED) {
+        unposted = true;
+      } else if (entry.state == Entry::ARMED
+                 && (!earliest || TicksUntil(entry, earliest->due_ticks) < 0)) {
+        earliest = &entry;
+      }
+    }
+    if (!earliest && !unposted) {
+      compare_timer.Disarm();
+      return;
+    }
+    int16_t lead = MIN_LEAD_TICKS;
+    while (true) {
+      const uint16_t now = compare_timer.NowTicks();
+      int16_t until = unposted ? RETRY_TICKS : INT16_MAX;
+      if (earliest && TicksUntil(*earliest, now) < until) {
+        until = TicksUntil(*earliest, now);
+      }
+      if (until < lead) {
+        until = lead;
+      }
+      const uint16_t ticks = now + until;
+      compare_timer.Arm(ticks);
+      // Else the counter passed the ticks before the timer was armed for them:
+      // the match would come one wrap (32 ms) late.
+      if (static_cast<int16_t>(ticks - compare_timer.NowTicks()) > 0) {
+        return;
+      }
+      lead *= 2;
+    }
+  }
+
+  // Frees a FIRED entry and resolves its promise. Run by the Scheduler.
+  void Complete(Entry& entry) {
+    PromiseWithResolve<void> completed = std::move(*entry.completed);
+    entry.completed.reset();
+    entry.callable = nullptr;
+    entry.state = Entry::FREE;
+    completed.Resolve();
+  }
+
+  // Non-volatile. Members accessed via this_nv
+  // are sure to be accessed by this thread only.
+  CompareMatchLane* this_nv() const volatile {
+    return const_cast<CompareMatchLane*>(this);
+  }
+
+  std::array<Entry, MAX_CALLABLES> entries_;
+};
@@ -0,0 +1,147 @@
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "os/ticks.h"
+
+using namespace std;
+
+
+class FakeTimer {
+public:
+  TimePoint Now() { return TimePoint(now_++); }
+
+  TimePoint SleepUntil(TimePoint time) {
+    if (TimePoint(now_) < time) {
+      now_ = time.ticks();
+    }
+    return TimePoint(now_);
+  }
+
+private:
+  uint32_t now_ = 0;
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
+
+#include "os/testing/fake_compare_timer.h"
+#include "os/compare_match_lane.h"
+
+
+volatile CompareMatchLane lane;
+
+// What the compare-match interrupt handler does.
+void HandleCompareMatch() {
+  Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+  lane.HandleCompareMatch();
+}
+
+
+int main() {
+  lane.Start();
+
+  {
+    // Callables are run from the interrupt handler at their exact ticks,
+    // in time order. Their promises are resolved by the scheduler, after.
+    vector<uint16_t> runs;
+    vector<int> completions;
+    lane.RunAfterMicros(10, [&runs]() {
+      runs.push_back(compare_timer_.NowTicks());
+    }).ThenVoid([&completions]() { completions.push_back(10); });
+    lane.RunAfterMicros(5, [&runs]() {
+      runs.push_back(compare_timer_.NowTicks());
+    }).ThenVoid([&completions]() { completions.push_back(5); });
+    assert(compare_timer_.armed() && compare_timer_.compare_ticks() == 10);
+
+    compare_timer_.Advance(9, HandleCompareMatch);
+    assert(runs.empty());
+    compare_timer_.Advance(1, HandleCompareMatch);
+    assert(runs == vector<uint16_t>({10}));
+    assert(compare_timer_.compare_ticks() == 20);
+    compare_timer_.Advance(15, HandleCompareMatch);
+    assert(runs == vector<uint16_t>({10, 20}));
+    assert(!compare_timer_.armed());
+
+    assert(completions.empty());  // Not before the scheduler runs.
+    scheduler.Loop();
+    assert(completions == vector<int>({5, 10}));
+  }
+
+  {
+    // A callable already due is run MIN_LEAD_TICKS later, not missed.
+    // Entries are reused once completed.
+    uint16_t run = 0;
+    bool completed = false;
+    const uint16_t now = compare_timer_.NowTicks();
+    for (int i = 0; i < 2 * CompareMatchLane::MAX_CALLABLES; ++i) {
+      lane.RunAfterMicros(0, [&run]() { run = compare_timer_.NowTicks(); })
+        .ThenVoid([&completed]() { completed = true; });
+      compare_timer_.Advance(CompareMatchLane::MIN_LEAD_TICKS,
+                             HandleCompareMatch);
+      scheduler.Loop();
+    }
+    assert(run == now + 2 * CompareMatchLane::MAX_CALLABLES
+                        * CompareMatchLane::MIN_LEAD_TICKS);
+    assert(completed);
+  }
+
+  {
+    // Should the counter pass the armed ticks before the timer is armed for
+    // them - here, it moves on during each read - the timer is armed again
+    // further ahead, rather than the callable being run a wrap late.
+    bool run = false;
+    compare_timer_.set_ticks_per_read(CompareMatchLane::MIN_LEAD_TICKS);
+    lane.RunAfterMicros(0, [&run]() { run = true; });
+    compare_timer_.set_ticks_per_read(0);
+    compare_timer_.Advance(2 * CompareMatchLane::MIN_LEAD_TICKS,
+                           HandleCompareMatch);
+    assert(run);
+    scheduler.Loop();
+  }
+
+  {
+    // A completion dropped by the full scheduler is posted again, RETRY_TICKS
+    // later.
+    bool run = false;
+    bool completed = false;
+    lane.RunAfterMicros(1, [&run]() { run = true; })
+      .ThenVoid([&completed]() { completed = true; });
+    vector<uint16_t> tasks;
+    uint16_t task;
+    while ((task = scheduler.RunAfterMicros(1000000, []() {}))
+           != scheduler.NO_TASK) {
+      tasks.push_back(task);
+    }
+    compare_timer_.Advance(CompareMatchLane::MIN_LEAD_TICKS,
+                           HandleCompareMatch);
+    assert(run && compare_timer_.armed());
+    for (uint16_t task : tasks) {
+      scheduler.Cancel(task);
+    }
+    compare_timer_.Advance(CompareMatchLane::RETRY_TICKS - 1,
+                           HandleCompareMatch);
+    assert(compare_timer_.armed());
+    compare_timer_.Advance(1, HandleCompareMatch);
+    assert(!compare_timer_.armed());
+    scheduler.Loop();
+    assert(completed);
+  }
+
+  {
+    // Across the wraparound of the compare timer.
+    compare_timer_.Advance(0xFFFF - compare_timer_.NowTicks() - 10,
+                           HandleCompareMatch);
+    uint16_t run = 0xFFFF;
+    lane.RunAfterMicros(CompareMatchLane::MAX_MICROS, [&run]() {
+      run = compare_timer_.NowTicks();
+    });
+    compare_timer_.Advance(2 * CompareMatchLane::MAX_MICROS - 1,
+                           HandleCompareMatch);
+    assert(run == 0xFFFF);
+    compare_timer_.Advance(1, HandleCompareMatch);
+    assert(run == 2 * CompareMatchLane::MAX_MICROS - 11);
+    scheduler.Loop();
+  }
+
+  return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#ifndef TEST_COMPARE_TIMER
+#include "os/compare_timer.h"
+inline volatile CompareTimer compare_timer;  // Global CompareTimer instance.
+#else
+auto& compare_timer = TEST_COMPARE_TIMER;  // Injected global CompareTimer.
+#endif
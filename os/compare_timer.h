@@ -0,0 +1,31 @@
+#pragma once
+
+#include "os/arduino.h"
+
+
+// Hardware timer with an output-compare unit: interrupts at a given tick,
+// rather than being polled like Timer. Counts in ticks of 1/TICKS_PER_MICRO
+// usec, wrapping around at 16 bits. See Arduino::StartCompareTimer().
+class CompareTimer {
+public:
+  static constexpr uint8_t TICKS_PER_MICRO = 2;
+
+  void Start() volatile {
+    Arduino::StartCompareTimer();
+  }
+
+  // To be called with interrupts disabled.
+  uint16_t NowTicks() volatile {
+    return Arduino::GetCompareTimerTicks();
+  }
+
+  // Raises the compare-match interrupt when the timer reaches given ticks.
+  // Replaces a previous Arm(). To be called with interrupts disabled.
+  void Arm(uint16_t ticks) volatile {
+    Arduino::SetCompareMatch(ticks);
+  }
+
+  void Disarm() volatile {
+    Arduino::ClearCompareMatch();
+  }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+
+
+// An entry of a static periodic task set, see CyclicExecutive: function is run
+// every period_micros, starting offset_micros into each period.
+// wcet_micros: worst-case execution time of function, if known (not 0) -
+// checked at compile time against the frames the function runs in.
+template <uint32_t period_micros, uint32_t offset_micros, void (*function)(),
+          uint32_t wcet_micros = 0>
+struct CyclicTask {
+  static constexpr uint32_t PERIOD_MICROS = period_micros;
+  static constexpr uint32_t OFFSET_MICROS = offset_micros;
+  static constexpr uint32_t WCET_MICROS = wcet_micros;
+
+  static void Run() { function(); }
+};
+
+
+namespace internal::cyclic_executive {
+
+template <typename... Ts>
+constexpr uint32_t Lcm(uint32_t value, Ts... values) {
+  if constexpr (sizeof...(values) == 0) {
+    return value;
+  } else {
+    return std::lcm(value, Lcm(values...));
+  }
+}
+
+// Bitmask of the tasks to run, per frame.
+template <typename MaskT, size_t num_frames, uint32_t minor_cycle_micros,
+          typename... CyclicTasks>
+constexpr std::array<MaskT, num_frames> MakeDispatchTable() {
+  constexpr uint32_t periods[] = {CyclicTasks::PERIOD_MICROS...};
+  constexpr uint32_t offsets[] = {CyclicTasks::OFFSET_MICROS...};
+  std::array<MaskT, num_frames> table = {};
+  for (uint32_t frame = 0; frame < num_frames; ++frame) {
+    const uint32_t time = frame * minor_cycle_micros;
+    for (uint8_t task = 0; task < sizeof...(CyclicTasks); ++task) {
+      if (time % periods[task] == offsets[task]) {
+        table[frame] |= MaskT(1) << task;
+      }
+    }
+  }
+  return table;
+}
+
+// Whether the known WCETs of the tasks of each frame add up to at most
+// the minor cycle.
+template <typename MaskT, size_t num_frames, uint32_t minor_cycle_micros,
+          typename... CyclicTasks>
+constexpr bool FramesFit(const std::array<MaskT, num_frames>& table) {
+  constexpr uint32_t wcets[] = {CyclicTasks::WCET_MICROS...};
+  for (uint32_t frame = 0; frame < num_frames; ++frame) {
+    uint32_t frame_micros = 0;
+    for (uint8_t task = 0; task < sizeof...(CyclicTasks); ++task) {
+      if (table[frame] & (MaskT(1) << task)) {
+        frame_micros += wcets[task];
+      }
+    }
+    if (frame_micros > minor_cycle_micros) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace internal::cyclic_executive
+
+
+// Runs a set of periodic tasks, fixed at compile time, from a static dispatch
+// table - a cyclic executive.
+//
+// Time is divided into minor cycles (frames) of minor_cycle_micros. The major
+// cycle is the hyperperiod of the tasks - the least common multiple of their
+// periods - after which the schedule repeats. The table holds, for each frame
+// of the major cycle, a bitmask of the tasks to run in the frame, in the order
+// of CyclicTasks. Computed at compile time: RunFrame() does no more than
+// a table lookup and a test of a bit per task.
+//
+// Compile-time checks:
+//   * periods and offsets are multiples of the minor cycle, offsets are within
+//     periods,
+//   * the major cycle is at most MAX_FRAMES frames long (the table size),
+//   * of tasks with a known WCET: the utilization is at most 1 and the tasks
+//     of each frame fit in the frame.
+//
+// Coexists with the dynamic Scheduler: Start() schedules the executive as
+// a single periodic TIME_CRITICAL task, run every minor cycle, with a budget
+// of one minor cycle (see Scheduler::SetBudgetMicros()). One-off tasks are
+// scheduled in the Scheduler as usual and are run between frames.
+//
+// Eg.
+//   using Executive = CyclicExecutive<5000,
+//     CyclicTask<10000, 0, &TriggerSensors, 200>,
+//     CyclicTask<10000, 5000, &ControlTick, 1000>,
+//     CyclicTask<100000, 5000, &SendTelemetry, 2000>>;
+//   Executive executive;
+//   executive.Start(scheduler);
+template <uint32_t minor_cycle_micros, typename... CyclicTasks>
+class CyclicExecutive {
+  using Mask = std::conditional_t<
+    sizeof...(CyclicTasks) <= 8, uint8_t,
+    std::conditional_t<sizeof...(CyclicTasks) <= 16, uint16_t, uint32_t>>;
+
+public:
+  static constexpr uint32_t MINOR_CYCLE_MICROS = minor_cycle_micros;
+  static constexpr uint32_t MAJOR_CYCLE_MICROS =
+    internal::cyclic_executive::Lcm(CyclicTasks::PERIOD_MICROS...);
+  static constexpr uint32_t NUM_FRAMES =
+    MAJOR_CYCLE_MICROS / MINOR_CYCLE_MICROS;
+  static constexpr uint32_t MAX_FRAMES = 64;
+  static constexpr uint8_t NUM_TASKS = sizeof...(CyclicTasks);
+
+  static_assert(NUM_TASKS > 0 && NUM_TASKS <= 32, "1 to 32 tasks.");
+  static_assert(((CyclicTasks::PERIOD_MICROS % MINOR_CYCLE_MICROS == 0
+                  && CyclicTasks::PERIOD_MICROS > 0) && ...),
+                "Task period not a multiple of the minor cycle.");
+  static_assert(((CyclicTasks::OFFSET_MICROS % MINOR_CYCLE_MICROS == 0
+                  && CyclicTasks::OFFSET_MICROS < CyclicTasks::PERIOD_MICROS)
+                 && ...),
+                "Task offset not a multiple of the minor cycle within period.");
+  static_assert(NUM_FRAMES <= MAX_FRAMES,
+                "Hyperperiod too long: too large dispatch table. "
+                "Harmonize task periods or lengthen the minor cycle.");
+  static_assert(((CyclicTasks::WCET_MICROS
+                  * (MAJOR_CYCLE_MICROS / CyclicTasks::PERIOD_MICROS)) + ...)
+                <= MAJOR_CYCLE_MICROS,
+                "Utilization over 1.");
+
+  // Runs the tasks of the current frame, then advances to the next frame.
+  // To be called every minor cycle, eg. by Start().
+  void RunFrame() {
+    RunTasks(DISPATCH_TABLE[frame_],
+             std::make_index_sequence<NUM_TASKS>());
+    if (++frame_ == NUM_FRAMES) {
+      frame_ = 0;
+    }
+  }
+
+  // Index of the frame to be run next, within the major cycle.
+  uint8_t frame() const { return frame_; }
+
+  // Schedules RunFrame() every minor cycle, starting after one minor cycle.
+  // Returns the TaskId of the scheduler task, eg. to Cancel() it.
+  template <typename SchedulerT>
+  auto Start(volatile SchedulerT& scheduler) {
+    const auto task_id = scheduler.RunEveryMicros(
+      MINOR_CYCLE_MICROS, [this]() { RunFrame(); });
+    scheduler.SetPriority(task_id, SchedulerT::Priority::TIME_CRITICAL);
+    if constexpr (MINOR_CYCLE_MICROS <= UINT16_MAX) {
+      scheduler.SetBudgetMicros(task_id, MINOR_CYCLE_MICROS);
+    }
+    return task_id;
+  }
+
+private:
+  template <size_t... tasks>
+  static void RunTasks(Mask mask, std::index_sequence<tasks...>) {
+    ((mask & (Mask(1) << tasks) ? CyclicTasks::Run() : void()), ...);
+  }
+
+  static constexpr std::array<Mask, NUM_FRAMES> DISPATCH_TABLE =
+    internal::cyclic_executive::MakeDispatchTable<
+      Mask, NUM_FRAMES, MINOR_CYCLE_MICROS, CyclicTasks...>();
+  static_assert(internal::cyclic_executive::FramesFit<
+                  Mask, NUM_FRAMES, MINOR_CYCLE_MICROS, CyclicTasks...>(
+                    DISPATCH_TABLE),
+                "Tasks of a frame do not fit in the minor cycle.");
+
+  uint8_t frame_ = 0;
+};
@@ -0,0 +1,91 @@
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "os/ticks.h"
+
+using namespace std;
+
+
+class FakeTimer {
+public:
+  TimePoint Now() { return TimePoint(now_++); }
+
+  TimePoint SleepUntil(TimePoint time) {
+    if (TimePoint(now_) < time) {
+      now_ = time.ticks();
+    }
+    return TimePoint(now_);
+  }
+
+private:
+  uint32_t now_ = 0;
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
+
+#include "os/cyclic_executive.h"
+#include "os/scheduler.h"
+
+
+// Times of the calls of each task.
+vector<uint32_t> sensor_calls, control_calls, telemetry_calls;
+
+void TriggerSensors() { sensor_calls.push_back(timer_.Now().ticks()); }
+void ControlTick() { control_calls.push_back(timer_.Now().ticks()); }
+void SendTelemetry() { telemetry_calls.push_back(timer_.Now().ticks()); }
+
+using Executive = CyclicExecutive<
+  1000,
+  CyclicTask<2000, 0, &TriggerSensors, 100>,
+  CyclicTask<2000, 1000, &ControlTick, 300>,
+  CyclicTask<6000, 1000, &SendTelemetry, 500>>;
+
+
+int main() {
+  static_assert(Executive::MAJOR_CYCLE_MICROS == 6000);
+  static_assert(Executive::NUM_FRAMES == 6);
+
+  {
+    // Frames 0..5 of the major cycle, then frame 0 again.
+    Executive executive;
+    vector<uint8_t> frames;
+    for (int i = 0; i < 7; ++i) {
+      frames.push_back(executive.frame());
+      executive.RunFrame();
+    }
+    assert(frames == vector<uint8_t>({0, 1, 2, 3, 4, 5, 0}));
+    assert(sensor_calls.size() == 4);     // Frames 0, 2, 4, 0.
+    assert(control_calls.size() == 3);    // Frames 1, 3, 5.
+    assert(telemetry_calls.size() == 1);  // Frame 1.
+  }
+
+  {
+    sensor_calls.clear();
+    control_calls.clear();
+    telemetry_calls.clear();
+
+    // Run by the Scheduler, together with a one-off task.
+    volatile Scheduler<const char> scheduler;
+    Executive executive;
+    const auto executive_task = executive.Start(scheduler);
+    uint32_t one_off_call = 0;
+    scheduler.RunAfterMicros(1000, [&]() { one_off_call = timer_.Now().ticks(); });
+    scheduler.RunAfterMicros(12500, [&]() { scheduler.Cancel(executive_task); });
+    scheduler.Loop();
+
+    // Frame n runs at (n + 1) * 1000, time-critical: ahead of the one-off task
+    // due at the same time.
+    assert(sensor_calls.size() == 6);  // 12 frames.
+    assert(control_calls.size() == 6);
+    assert(telemetry_calls.size() == 2);
+    assert(control_calls[0] < telemetry_calls[0]);  // Order in CyclicTasks.
+    assert(1000 <= sensor_calls[0] && sensor_calls[0] < 1050);
+    assert(3000 <= sensor_calls[1] && sensor_calls[1] < 3050);
+    assert(8000 <= telemetry_calls[1] && telemetry_calls[1] < 8050);
+    assert(sensor_calls[0] < one_off_call);
+    assert(scheduler.num_budget_overruns() == 0);
+  }
+
+  return 0;
+}
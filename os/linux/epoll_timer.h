@@ -0,0 +1,174 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "lib/check.h"
+#include "lib/inline_function.h"
+#include "os/thread.h"
+#include "os/ticks.h"
+
+
+// Timer of a Linux process, eg. the controller on a companion computer or in
+// CI (see os/timer-global.h). Timer's API on CLOCK_MONOTONIC, in usec ticks
+// (see os/ticks.h) since the timer was created.
+//
+// SleepUntil() blocks in epoll_wait() on a timerfd armed for given time and
+// on the file descriptors registered with Watch(): an idle process takes no
+// CPU, and wakes up on time - within the kernel's timer latency, typically
+// tens of usec - or on input.
+//
+// File descriptors are the host's interrupts: the handler of a file
+// descriptor that is ready is run from SleepUntil() as if from an interrupt
+// handler (see Thread). Eg. it reads the input and schedules its processing
+// with the Scheduler, which passes the task to its loop as it does tasks
+// scheduled by interrupt handlers. A handler must consume the input, as
+// epoll is level-triggered, or Unwatch() the file descriptor.
+class EpollTimer {
+public:
+  static constexpr uint8_t MAX_FDS = 8;
+
+  // Run as if from an interrupt handler, see above.
+  using FdHandler = InlineFunction<void(), 2 * sizeof(void*)>;
+
+  EpollTimer()
+      : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+        timer_fd_(
+          timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+        start_nanos_(MonotonicNanos()) {
+    CHECK(epoll_fd_ >= 0 && timer_fd_ >= 0);
+    AddToEpoll(timer_fd_);
+  }
+
+  ~EpollTimer() {
+    close(timer_fd_);
+    close(epoll_fd_);
+  }
+
+  TimePoint Now() volatile {
+    return ToTimePoint(MonotonicNanos());
+  }
+
+  // Blocks until given time or until a watched file descriptor is ready,
+  // whichever is first, and runs handlers of those that are ready. Returns the
+  // time after.
+  TimePoint SleepUntil(TimePoint time) volatile {
+    EpollTimer* const this_ = this_nv();
+    const uint64_t now_nanos = MonotonicNanos();
+    const TimePoint now = this_->ToTimePoint(now_nanos);
+    if (!(now < time)) {
+      return now;
+    }
+    // At the start of time's usec tick.
+    const uint64_t wake_up_nanos = now_nanos
+      - (now_nanos - this_->start_nanos_) % 1000
+      + uint64_t((time - now).count()) * 1000;
+    itimerspec wake_up = {};
+    wake_up.it_value.tv_sec = wake_up_nanos / 1000000000;
+    wake_up.it_value.tv_nsec = wake_up_nanos % 1000000000;
+    [[maybe_unused]] const int armed = timerfd_settime(
+      this_->timer_fd_, TFD_TIMER_ABSTIME, &wake_up, nullptr);
+    CHECK(armed == 0);
+
+    std::array<epoll_event, MAX_FDS + 1> events;
+    // Interrupted by a signal: returns early, as on an interrupt.
+    const int num_events =
+      epoll_wait(this_->epoll_fd_, events.data(), events.size(), -1);
+    for (int i = 0; i < num_events; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == this_->timer_fd_) {
+        uint64_t num_expirations;
+        static_cast<void>(
+          read(fd, &num_expirations, sizeof(num_expirations)));
+        continue;
+      }
+      WatchedFd* const watch = this_->FindWatch(fd);
+      if (watch) {  // Else unwatched by an earlier handler.
+        Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+        watch->handler();
+      }
+    }
+    return Now();
+  }
+
+  // Runs given handler whenever given file descriptor has input, from
+  // SleepUntil(). Returns false if MAX_FDS are already watched.
+  bool Watch(int fd, FdHandler&& handler) volatile {
+    EpollTimer* const this_ = this_nv();
+    WatchedFd* const watch = this_->FindWatch(NO_FD);
+    if (!watch) {
+      return false;
+    }
+    watch->fd = fd;
+    watch->handler = std::move(handler);
+    this_->AddToEpoll(fd);
+    return true;
+  }
+
+  // May be called from the file descriptor's handler.
+  void Unwatch(int fd) volatile {
+    EpollTimer* const this_ = this_nv();
+    WatchedFd* const watch = this_->FindWatch(fd);
+    if (!watch) {
+      return;
+    }
+    [[maybe_unused]] const int deleted =
+      epoll_ctl(this_->epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    CHECK(deleted == 0);
+    watch->fd = NO_FD;  // The handler is kept, in case it is being run.
+  }
+
+private:
+  static constexpr int NO_FD = -1;
+
+  struct WatchedFd {
+    int fd = NO_FD;
+    FdHandler handler;
+  };
+
+  static uint64_t MonotonicNanos() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+  }
+
+  // Modulo 2^32 usec, ~71 minutes: compared wrap-safe.
+  TimePoint ToTimePoint(uint64_t nanos) const volatile {
+    return TimePoint(uint32_t((nanos - this_nv()->start_nanos_) / 1000));
+  }
+
+  void AddToEpoll(int fd) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    [[maybe_unused]] const int added =
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    CHECK(added == 0);
+  }
+
+  WatchedFd* FindWatch(int fd) {
+    for (WatchedFd& watch : watches_) {
+      if (watch.fd == fd) {
+        return &watch;
+      }
+    }
+    return nullptr;
+  }
+
+  // Non-volatile. Members accessed via this_nv
+  // are sure to be accessed by this thread only.
+  EpollTimer* this_nv() const volatile {
+    return const_cast<EpollTimer*>(this);
+  }
+
+  const int epoll_fd_;
+  const int timer_fd_;
+  const uint64_t start_nanos_;
+  std::array<WatchedFd, MAX_FDS> watches_;
+};
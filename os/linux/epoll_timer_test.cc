@@ -0,0 +1,77 @@
+#include <time.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#include "os/linux/fd_stream.h"
+#include "os/scheduler-global.h"  // With the global EpollTimer.
+
+
+// Of this process, in usec.
+uint32_t CpuMicros() {
+  timespec cpu;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+  return cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+}
+
+struct Pipe;  // FdStream tag.
+
+
+int main() {
+  {
+    // Sleeps until the time, without spinning. How late it wakes up depends
+    // on the load of the host: not asserted.
+    const TimePoint start = timer.Now();
+    const uint32_t start_cpu = CpuMicros();
+    const TimePoint end = timer.SleepUntil(start + Ticks::FromMicros(20000));
+    assert(end - start >= Ticks::FromMicros(20000));
+    assert(CpuMicros() - start_cpu < 2000);
+  }
+
+  int pipe_fds[2];
+  assert(pipe(pipe_fds) == 0);
+  FdStream<Pipe>::in_fd = pipe_fds[0];
+  FdStream<Pipe>::out_fd = pipe_fds[1];
+
+  {
+    // Wakes up on input, and runs its handler as an interrupt handler.
+    char input = 0;
+    bool from_interrupt = false;
+    assert(timer.Watch(pipe_fds[0], [&input, &from_interrupt]() {
+      FdStream<Pipe>::Read(&input, 1);
+      from_interrupt = Thread::is_interrupt();
+    }));
+    FdStream<Pipe>::Write('a');
+    FdStream<Pipe>::Flush();
+    const TimePoint start = timer.Now();
+    timer.SleepUntil(start + Ticks::FromMicros(10000000));
+    assert(timer.Now() - start < Ticks::FromMicros(1000000));
+    assert(input == 'a' && from_interrupt);
+    timer.Unwatch(pipe_fds[0]);
+  }
+
+  {
+    // Scheduler's loop: a task writes to the pipe, whose handler schedules
+    // a task that reads what was written.
+    char input[8] = {};
+    bool read = false;
+    assert(timer.Watch(pipe_fds[0], [&input, &read]() {
+      timer.Unwatch(FdStream<Pipe>::in_fd);
+      scheduler.RunAsync([&input, &read]() {
+        read = FdStream<Pipe>::Read(input, sizeof(input)) == 5;
+      });
+    }));
+    scheduler.RunAfterMicros(10000, []() {
+      FdStream<Pipe>::Write("hello", 5);
+      FdStream<Pipe>::Flush();
+    });
+    // Keeps the loop running until read.
+    scheduler.RunEveryMicrosUntil(5000, [&read]() { return read; });
+    scheduler.Loop();
+    assert(read && std::string(input) == "hello");
+  }
+
+  return 0;
+}
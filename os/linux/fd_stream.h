@@ -0,0 +1,77 @@
+#pragma once
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+
+// Serial-style stream on file descriptors of a Linux process, in place of the
+// board's serial port: a StreamT of logs (see lib/text_log.h,
+// lib/binary_log.h). Stdin and stdout by default, or eg. the ends of pipes or
+// a pseudo-terminal.
+//
+// Writes are buffered until Flush(), as by the serial port's transmit buffer,
+// or until the buffer fills up. If the output fails, eg. is closed, what is
+// written is lost, as on a disconnected serial port.
+//
+// Static, as StreamT is: one stream per Tag type. Eg.
+//   struct Telemetry;
+//   FdStream<Telemetry>::out_fd = pipe_fds[1];
+//   BinaryLog<FdStream<Telemetry>> telemetry_log;
+template <typename Tag = void>
+class FdStream {
+public:
+  static inline int in_fd = STDIN_FILENO;
+  static inline int out_fd = STDOUT_FILENO;
+
+  static void Write(char c) { Write(&c, 1); }
+
+  static void Write(const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+      if (length_ == BUFFER_SIZE) {
+        Flush();
+      }
+      const size_t n = std::min(size, BUFFER_SIZE - length_);
+      std::memcpy(buffer_ + length_, p, n);
+      length_ += n;
+      p += n;
+      size -= n;
+    }
+  }
+
+  static void Flush() {
+    size_t written = 0;
+    while (written < length_) {
+      const ssize_t n = ::write(out_fd, buffer_ + written, length_ - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        break;
+      }
+      written += n;
+    }
+    length_ = 0;
+  }
+
+  // Reads up to size bytes of input. Does not block once in_fd is ready,
+  // eg. from its handler (see EpollTimer::Watch()). Returns the number of
+  // bytes read: 0 at the end of input or on error.
+  static size_t Read(void* data, size_t size) {
+    ssize_t n;
+    do {
+      n = ::read(in_fd, data, size);
+    } while (n < 0 && errno == EINTR);
+    return n > 0 ? n : 0;
+  }
+
+private:
+  static constexpr size_t BUFFER_SIZE = 256;
+
+  static inline char buffer_[BUFFER_SIZE];
+  static inline size_t length_ = 0;
+};
@@ -1,10 +1,13 @@
 
 #pragma once
 
+#include <optional>
+
 #include "lib/check.h"
 #include "lib/log.h"
 #include "os/arduino.h"
 #include "lib/promise.h"
+#include "os/scheduler-global.h"
 #include "os/timer-global.h"
 
 
@@ -51,11 +54,11 @@ public:
   template <uint32_t poll_frequency_usec>
   Promise<uint32_t> OnceGoesHigh() const {
     CHECK(IsLow());
-    return OnceChanges([this](uint32_t micros) {
-      CHECK(IsHigh());
-      DLOG(INFO) << P("pin=") << pin_ << P(" HIGH");
-      return micros;
-    });
+    return OnceInState<poll_frequency_usec>(PinState::HIGH).Then(
+      [this](uint32_t micros) {
+        DLOG(INFO) << P("pin=") << pin_ << P(" HIGH");
+        return micros;
+      });
   }
 
   // TODO until the pin goes from low to low.
@@ -63,11 +66,11 @@ public:
   template <uint32_t poll_frequency_usec>
   Promise<uint32_t> OnceGoesLow() const {
     CHECK(IsHigh());
-    return OnceChanges([this](uint32_t micros) {
-      CHECK(IsLow());
-      DLOG(INFO) << P("pin=") << pin_ << P(" LOW");
-      return micros;
-    });
+    return OnceInState<poll_frequency_usec>(PinState::LOW).Then(
+      [this](uint32_t micros) {
+        DLOG(INFO) << P("pin=") << pin_ << P(" LOW");
+        return micros;
+      });
   }
 
   // Repeatedly polls the pin, via periodic scheduler tasks, until it spikes:
@@ -76,9 +79,9 @@ public:
   // occur.
   template <uint32_t poll_frequency_usec>
   Promise<uint32_t> OnceSpikes() const {
-    return OnceGoesHigh<poll_frequency_usec>().template Then<uint32_t>(
+    return OnceGoesHigh<poll_frequency_usec>().Then(
       [this](uint32_t time_high_usec) {
-      return OnceGoesLow<poll_frequency_usec>().template Then<uint32_t>(
+      return OnceGoesLow<poll_frequency_usec>().Then(
         [time_high_usec](uint32_t time_low_usec) {
           const uint32_t spike_duration_usec = time_low_usec - time_high_usec;
           return spike_duration_usec;
@@ -86,9 +89,19 @@ public:
     });
   }
 
-  template <typename F>
-  Promise<uint32_t> OnceChanges(F&& f) {
-    // return pin_monitor.OnceChanges(pin_, std::move(f));
+private:
+  // Polls the pin, via a periodic scheduler task, until it is in given state.
+  // The returned promise is resolved with the time of that poll, in usec.
+  // TODO: Via pin_monitor, from the pin change interrupt, rather than polled.
+  template <uint32_t poll_frequency_usec>
+  Promise<uint32_t> OnceInState(State state) const {
+    return scheduler.RunEveryMicrosUntilResolved<uint32_t>(
+      poll_frequency_usec, [this, state]() -> std::optional<uint32_t> {
+        if (GetState() != state) {
+          return std::nullopt;
+        }
+        return timer.Now().ToMicros();
+      });
   }
 };
 
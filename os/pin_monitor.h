@@ -10,6 +10,7 @@
 #include "arduino-ext/critical_section.h"
 #include "os/arduino.h"
 #include "os/scheduler_executor-global.h"
+#include "os/ticks.h"
 #include "os/timer-global.h"
 
 
@@ -40,21 +41,21 @@ public:
     callback = f;
   }
 
-  using callback_t = std::function<void(PinState, uint32_t)>;
+  using callback_t = std::function<void(PinState, TimePoint)>;
 
 private:
   template <size_t pin>
   static void EnablePinChangeInterrupt();
 
   struct PinStateSnapshot {
-    uint32_t micros;
+    TimePoint time;
     PinState pin_states_new[MAX_PINS];
   };
 
 public:  // TODO: private
   void HandlePinChangeInterrupt() volatile {
     PinStateSnapshot snapshot;
-    snapshot.micros = timer.Now();
+    snapshot.time = timer.Now();
 
     // Read pin states. TODO: Batch read.
     for (uint8_t i = 0; i < num_pins_; ++i) {
@@ -80,7 +81,7 @@ private:
           // so that the callback can register another callback.
           callback_t callback;
           change_callbacks_[i].swap(callback);
-          callback(pin_state_new, snapshot.micros);
+          callback(pin_state_new, snapshot.time);
         }
         pin_states_[i] = pin_state_new;
       }
@@ -0,0 +1,79 @@
+// Part of os/scheduler.h implementation that requires coroutines (C++20).
+// See lib/coroutine.h.
+
+#pragma once
+
+#include <coroutine>
+
+#include "lib/coroutine.h"
+#include "os/scheduler-global.h"
+#include "os/timer-global.h"
+
+
+// co_await SleepMicros(micros): resumes the coroutine after given number of
+// microseconds, directly from a scheduler task of given priority. Unlike
+// co_await scheduler.AfterMicros(micros), involves no Promise: no allocation
+// and no further task to run a Then() handler. If the scheduler drops the
+// task (no free slot), the coroutine is resumed right away, without sleeping,
+// rather than never.
+inline auto SleepMicros(uint32_t micros,
+                        TaskPriority priority = TaskPriority::NORMAL) {
+  struct Awaiter {
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) const {
+      const auto task_id = scheduler.RunAfterMicros(
+        micros, [coroutine]() { coroutine.resume(); },
+        P("resume() SleepMicros()"));
+      if (task_id == scheduler.NO_TASK) {
+        return false;  // Resumes now.
+      }
+      if (priority != TaskPriority::NORMAL) {
+        scheduler.SetPriority(task_id, priority);
+      }
+      return true;
+    }
+
+    void await_resume() const {}
+
+    uint32_t micros;
+    TaskPriority priority;
+  };
+  return Awaiter{micros, priority};
+}
+
+
+// co_await OncePinState<poll_frequency_usec>(pin, state): resumes the
+// coroutine once the pin is in given state, polled every poll_frequency_usec
+// by a periodic scheduler task. Returns the time the state was detected,
+// in usec. PinT: eg. InputPin - anything with State GetState() const.
+//
+// Waits for a level, not an edge: if the pin is already in given state, the
+// coroutine is resumed at the first poll. For an edge, await the opposite
+// state first. If the scheduler drops the polling task (no free slot),
+// resumes right away, with time 0.
+template <uint32_t poll_frequency_usec, typename PinT, typename StateT>
+auto OncePinState(const PinT& pin, StateT state) {
+  struct Awaiter {
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+      return scheduler.RunEveryMicrosUntil(
+        poll_frequency_usec, [this, coroutine]() {
+          if (pin.GetState() != state) {
+            return false;
+          }
+          time_usec = timer.Now().ToMicros();
+          coroutine.resume();  // May destroy this awaiter.
+          return true;
+        }, P("resume() OncePinState()")) != scheduler.NO_TASK;
+    }
+
+    uint32_t await_resume() const { return time_usec; }
+
+    const PinT& pin;
+    const StateT state;
+    uint32_t time_usec = 0;
+  };
+  return Awaiter{pin, state};
+}
@@ -3,10 +3,21 @@
 #include "lib/promise.h"
 #include "os/scheduler.h"
 
-template <typename DescriptionT>
-Promise<void> Scheduler<DescriptionT>::AfterMicros(uint32_t micros) volatile {
+template <typename DescriptionT,
+          template <size_t> class TaskQueueT, size_t max_tasks,
+          typename StatsT, typename ConcurrencyT>
+Promise<void>
+Scheduler<DescriptionT, TaskQueueT, max_tasks, StatsT,
+          ConcurrencyT>::AfterMicros(uint32_t micros,
+                                     Priority priority) volatile {
   PromiseWithResolve<void> promise;
-  RunAfterMicros(micros, [promise]() mutable { promise.Resolve(); },
-                 P("Resolve() AfterMicros()"));
+  const TaskId task_id = RunAfterMicros(
+    micros, [promise]() mutable { promise.Resolve(); },
+    P("Resolve() AfterMicros()"));
+  if (task_id == NO_TASK) {  // Dropped: resolved right away, rather than never.
+    promise.Resolve();
+  } else if (priority != Priority::NORMAL) {
+    SetPriority(task_id, priority);
+  }
   return promise;
 }
@@ -2,19 +2,31 @@
 
 #pragma once
 
+#include <array>
 #include <functional>
 #include <optional>
+#include <type_traits>
 #include <utility>
 
-#include "arduino-ext/critical_section.h"
 #include "lib/check.h"
 #include "lib/circular_buffer.h"
-#include "lib/fixed_capacity_vector.h"
+#include "lib/inline_function.h"
 #include "lib/log.h"
-#include "lib/priority_queue.h"
+#include "lib/spsc_queue.h"
 #include "lib/template_metaprogramming.h"
-#include "os/timer-global.h"
+#include "os/scheduler_concurrency.h"
+#include "os/scheduler_stats.h"
+#include "os/task_queue.h"
 #include "os/thread.h"
+#include "os/ticks.h"
+#include "os/timer-global.h"
+
+// Class of a scheduled task, in the order due tasks are run. See Scheduler.
+enum class TaskPriority : uint8_t {
+  TIME_CRITICAL,  // Eg. I/O that must follow an event within microseconds.
+  NORMAL,
+  BACKGROUND,     // Eg. bulk telemetry, log flushing.
+};
 
 template <typename T> class Promise;
 template <typename T> class PromiseWithResolve;
@@ -44,59 +56,410 @@ template <typename T> class PromiseWithResolve;
 // callables. Note: At least one callable must be scheduled before calling
 // Loop(), otherwise it returns immediately.
 //
-// TODO: thread safety.
+// Scheduled tasks are kept in a fixed slab of max_tasks task slots, and
+// ordered by time in a TaskQueueT backend (see os/task_queue.h) of slot
+// indices: HeapTaskQueue (default) or TimingWheelTaskQueue. The choice does not
+// affect the API. A task holds its slot from being scheduled until it
+// completes, including while it is being run.
+//
+// Tasks that are due are run in order of their Priority class, then of their
+// deadlines (earliest deadline first), then of their scheduled times. By
+// default all tasks are NORMAL and without a deadline: run in time order.
+// Scheduling is not preemptive: a task that has started runs to completion,
+// even if a more urgent task becomes due meanwhile. BACKGROUND tasks are
+// protected from starvation (see MAX_BACKGROUND_WAIT_MICROS).
+//
+// Tasks scheduled with RunAsync() - to be run as soon as possible, eg. Promise
+// continuations - bypass the task queue: they are appended to a FIFO of async
+// tasks and run in the order they were scheduled. Fairness between the two:
+// a due TIME_CRITICAL task is run ahead of async tasks, and any other due task
+// waits for at most MAX_ASYNC_TASKS_IN_A_ROW async tasks.
+//
+// Tasks may be given slack: allowed to be run somewhat late, so that tasks
+// due close to each other are run after a single wakeup from idle sleep.
+//
+// A TaskId is a handle of a task's slot plus the slot's generation,
+// incremented each time the slot is freed. A TaskId of a task that has
+// completed or been canceled is stale and is ignored by Cancel(), even if its
+// slot has been reused by another task.
 //
-// TODO: Use C++ duration<> in place of uint32_t to disambiguate time units.
-template <typename DescriptionT = const char>
-class Scheduler {
+// Tasks may be scheduled from interrupt handlers. Such tasks are passed to
+// the main thread through a lock-free queue of new tasks, merged into the
+// task queue by Loop(). Interrupts are disabled only for a few instructions
+// at a time, to take or return a free slot. An application that schedules
+// tasks from the main thread only may opt out of this with ConcurrencyT (see
+// os/scheduler_concurrency.h): with MainThreadScheduling, interrupts are never
+// disabled and the queue of new tasks is compiled out of the loop.
+//
+// If no slot is free, or the queue of new tasks from interrupt handlers is
+// full, a scheduled task is dropped: NO_TASK is returned in place of its
+// TaskId, and num_dropped_tasks() is incremented. Callers handle it, rather
+// than leave a promise or a coroutine waiting forever: eg. AfterMicros()
+// resolves its promise right away, SchedulerExecutor runs the callable right
+// away.
+//
+// Time is kept in native timer ticks and compared wrap-safe (see os/ticks.h):
+// the scheduler runs correctly across the timer's wraparound. The API takes
+// usec, converted to ticks once, when a task is scheduled.
+//
+// Optionally, tasks are instrumented: StatsT (see os/scheduler_stats.h)
+// records how late each task starts and how long it runs. With the default
+// NoSchedulerStats, instrumentation is compiled out.
+//
+// A task may be given a run time budget (SetBudgetMicros()). A run over
+// budget is reported, and the loop goes on: the cooperative task cannot be
+// preempted. Checked when the task returns and, optionally, from a timer
+// interrupt while the task runs (see os/task_budget_watchdog.h).
+//
+// The run time of each periodic task is measured, and the utilization of the
+// loop by periodic tasks - the sum of their run times per period - estimated
+// (see utilization()). A periodic task may be admitted only if it fits
+// (RunEveryMicrosIfFits()), and may be sheddable: stretched to a longer
+// period while the loop is overloaded (SetSheddable()). Shedding is logged.
+//
+// TODO: thread safety. Cancel() is to be called from the main thread only.
+template <typename DescriptionT = const char,
+          template <size_t> class TaskQueueT = HeapTaskQueue,
+          size_t max_tasks = 24,
+          typename StatsT = NoSchedulerStats,
+          typename ConcurrencyT = InterruptSafeScheduling>
+class Scheduler : private StatsT {  // Base: takes no space if empty.
 protected:
-  static constexpr size_t MAX_TASKS = 24;
-  static constexpr size_t MAX_NEW_TASKS = 8;  // TODO: Merge into single queue.
+  static constexpr size_t MAX_TASKS = max_tasks;
+  static_assert(MAX_TASKS < 0xFF, "Too many tasks for 8-bit task slots.");
+  static constexpr uint8_t MAX_NEW_TASKS = 8;  // From interrupt handlers.
+
+  using Slot = uint8_t;
+  static constexpr Slot NO_SLOT = 0xFF;
 
   struct Task;
-  struct TaskGreater;
-  using TaskQueue = PriorityQueue<
-    Task, FixedCapacityVector<Task, MAX_TASKS>, TaskGreater>;
-  using NewTaskQueue = CircularBuffer<Task, MAX_TASKS>;
+  using TaskQueue = TaskQueueT<MAX_TASKS>;
+  using NewTaskQueue = SpscQueue<Slot, MAX_NEW_TASKS>;
 
 public:
-  using TaskId = uint8_t;
+  // Slot generation in the high byte, slot in the low byte.
+  using TaskId = uint16_t;
+  static constexpr TaskId NO_TASK = 0xFFFF;  // Never a valid TaskId.
+
+  // Max size of a scheduled callable (eg. of a lambda's captures). Fits
+  // a std::function plus a few pointers, eg. a Promise continuation bound
+  // to its argument. Larger callables fail to compile.
+  static constexpr size_t MAX_CALLABLE_SIZE =
+    sizeof(std::function<void()>) + 3 * sizeof(void*);
+
+  // Scheduled callable. Stored inline in the task, so that scheduling a task
+  // does not allocate memory.
+  using Callable = InlineFunction<void(), MAX_CALLABLE_SIZE>;
+
+  // What a periodic task does when it overruns: completes after its next
+  // run is due, eg. because it or another task took longer than its period.
+  enum class Overrun : uint8_t {
+    // Runs the missed periods back to back, each next run due one period
+    // after the previous one was due. Keeps the number of runs.
+    CATCH_UP,
+    // Skips the missed periods: the next run is due at the first period
+    // boundary after the task completes. Keeps the phase.
+    SKIP,
+    // The next run is due one period after the task completes. Keeps the
+    // minimum interval between runs.
+    DELAY,
+  };
+
+  using Priority = TaskPriority;
+
+  // Relative deadline of a task without one: the latest.
+  static constexpr uint16_t NO_DEADLINE = 0xFFFF;
+
+  // A BACKGROUND task due for this long is run as a NORMAL one, so that
+  // it is not starved by a steady stream of NORMAL tasks.
+  static constexpr uint32_t MAX_BACKGROUND_WAIT_MICROS = 10000;
+
+  // Max number of async tasks (see RunAsync()) run back to back while a task
+  // scheduled for a time is due.
+  static constexpr uint8_t MAX_ASYNC_TASKS_IN_A_ROW = 4;
+
+  // Utilization of the loop, see utilization(): all of its time.
+  static constexpr uint16_t FULL_UTILIZATION = 1024;
+
+  // A sheddable task's period is stretched by up to 2^MAX_SHED.
+  static constexpr uint8_t MAX_SHED = 15;
+
+protected:
+  // Of the above, in ticks.
+  static constexpr ShortTicks NO_DEADLINE_TICKS =
+    ShortTicks::FromMicros(NO_DEADLINE);
+  static constexpr Ticks MAX_BACKGROUND_WAIT =
+    Ticks::FromMicros(MAX_BACKGROUND_WAIT_MICROS);
+
+public:
+  Scheduler() {
+    for (Slot slot = 0; slot < MAX_TASKS; ++slot) {
+      free_slots_[slot] = MAX_TASKS - 1 - slot;  // Hand out slot 0 first.
+    }
+  }
 
   // Schedules a callable to be run after given number of microseconds.
-  TaskId RunAfterMicros(uint32_t micros, std::function<void()>&& callable,
-                        DescriptionT* description = nullptr) volatile {
+  //
+  // slack_micros: how much later than scheduled the callable may be run.
+  // Allows the scheduler to coalesce tasks: to wake up from idle sleep once
+  // for several tasks due within their slack of each other, and run them in
+  // one pass. See num_coalesced_tasks().
+  TaskId RunAfterMicros(uint32_t micros, Callable&& callable,
+                        DescriptionT* description = nullptr,
+                        uint16_t slack_micros = 0) volatile {
     return EmplaceNewTask(
-      timer.Now() + micros, 0, std::move(callable), description);
+      timer.Now() + Ticks::FromMicros(micros), Ticks(), std::move(callable),
+      description, Overrun::CATCH_UP, ShortTicks::FromMicros(slack_micros));
+  }
+
+  // Schedules a callable to be run as soon as possible: after the async tasks
+  // scheduled before it, in FIFO order, and subject to the fairness rules
+  // towards due tasks (see class doc). Does not read the timer and does not
+  // touch the task queue. Priority and deadline do not apply to async tasks.
+  // An async task scheduled by an interrupt handler joins the FIFO when
+  // merged by Loop().
+  TaskId RunAsync(Callable&& callable,
+                  DescriptionT* description = nullptr) volatile {
+    return EmplaceNewTask(
+      StatsT::ENABLED ? timer.Now() : TimePoint(), Ticks(),
+      std::move(callable), description, Overrun::CATCH_UP, ShortTicks(),
+      /*async=*/true);
   }
 
   // Schedules a callable to be run repeatedly every given number
-  // of microseconds, starting after one such period.
-  TaskId RunEveryMicros(uint32_t micros, std::function<void()>&& callable,
-                        DescriptionT* description = nullptr) volatile {
+  // of microseconds, starting after one such period. slack_micros: see
+  // RunAfterMicros(), applies to each run. Slack does not shift the phase
+  // of the runs.
+  TaskId RunEveryMicros(uint32_t micros, Callable&& callable,
+                        DescriptionT* description = nullptr,
+                        Overrun overrun = Overrun::CATCH_UP,
+                        uint16_t slack_micros = 0) volatile {
+    const Ticks period = Ticks::FromMicros(micros);
     return EmplaceNewTask(
-      timer.Now() + micros, micros, std::move(callable), description);
+      timer.Now() + period, period, std::move(callable), description, overrun,
+      ShortTicks::FromMicros(slack_micros));
   }
 
   // Schedules a callable to be run repeatedly every given number
   // of microseconds, starting after one such period, until the callable
   // returns true.
-  TaskId RunEveryMicrosUntil(uint32_t micros, std::function<bool()>&& callable,
-                             DescriptionT* description = nullptr) volatile {
-    // This is not thread safe! TODO: Use task_id returned from RunEveryMicros.
+  template <typename F>
+  TaskId RunEveryMicrosUntil(uint32_t micros, F&& callable,
+                             DescriptionT* description = nullptr,
+                             Overrun overrun = Overrun::CATCH_UP,
+                             uint16_t slack_micros = 0) volatile {
     return RunEveryMicros(
-      micros, [this, callable = std::move(callable), task_id = next_task_id_]() {
+      micros, [this, callable = std::forward<F>(callable)]() mutable {
         if (callable()) {
-          Cancel(task_id);
+          CancelRunningTask();
         }
-      }, description);
+      }, description, overrun, slack_micros);
+  }
+
+  // Admission control. Schedules a callable to be run repeatedly, as
+  // RunEveryMicros() does, if it fits: if the estimated utilization (see
+  // utilization()) plus that of the callable, expected to run for run_micros
+  // per period, does not exceed max_utilization(). Otherwise degrades it, if
+  // max_period_micros allows: schedules it every 2, 4, ... times micros,
+  // the shortest of these that fits, and sheddable (see SetSheddable()).
+  // Else rejects it: returns NO_TASK. To be called from the main thread.
+  TaskId RunEveryMicrosIfFits(uint32_t micros, uint16_t run_micros,
+                              Callable&& callable,
+                              DescriptionT* description = nullptr,
+                              uint32_t max_period_micros = 0) volatile {
+    Scheduler* const this_ = this_nv();
+    const ShortTicks run_time = ShortTicks::FromMicros(run_micros);
+    const Ticks max_period = Ticks::FromMicros(max_period_micros);
+    Ticks period = Ticks::FromMicros(micros);
+    uint8_t shed = 0;
+    while (this_->utilization_ + Utilization(run_time, period)
+           > this_->max_utilization_) {
+      if (shed == MAX_SHED || period.count() > max_period.count() / 2) {
+        if (description) {
+          LOG(INFO) << P("rejected task description=") << description
+                    << P(" utilization=") << this_->utilization_;
+        } else {
+          LOG(INFO) << P("rejected task utilization=") << this_->utilization_;
+        }
+        return NO_TASK;
+      }
+      period += period;
+      ++shed;
+    }
+    const TaskId task_id = EmplaceNewTask(
+      timer.Now() + period, period, std::move(callable), description);
+    if (task_id == NO_TASK) {
+      return NO_TASK;
+    }
+    const Slot slot = task_id & 0xFF;
+    Task& task = this_->slots_[slot];
+    task.shed = shed;
+    this_->SetLoad(task, run_time, period);
+    SetSheddable(task_id, max_period_micros);
+    if (shed) {
+      this_->LogShed(slot);
+    }
+    return task_id;
+  }
+
+  // Makes a periodic task sheddable: while the loop is overloaded - the
+  // estimated utilization exceeds max_utilization() - each run of the task
+  // doubles its period, up to max_period_micros. Once the loop is no longer
+  // overloaded with the period halved, each run halves it back, down to the
+  // task's own period. Each change is logged. Returns false if the task has
+  // already completed or been canceled. To be called from the main thread.
+  bool SetSheddable(TaskId task_id, uint32_t max_period_micros) volatile {
+    Scheduler* const this_ = this_nv();
+    Task* const task = this_->FindTask(task_id);
+    if (!task) {
+      return false;
+    }
+    const Ticks period(task->period.count() >> task->shed);
+    const Ticks max_period = Ticks::FromMicros(max_period_micros);
+    uint8_t max_shed = 0;
+    while (max_shed < MAX_SHED
+           && (period.count() << max_shed) <= max_period.count() / 2) {
+      ++max_shed;
+    }
+    task->max_shed = max_shed;
+    if (task->shed > max_shed) {
+      task->shed = max_shed;
+      this_->SetLoad(*task, task->run_time, Ticks(period.count() << max_shed));
+    }
+    return true;
   }
 
-  // Cancels a scheduled callable.
-  void Cancel(TaskId task_id) volatile {
+  // Estimated utilization of the loop by periodic tasks, in
+  // 1/FULL_UTILIZATION: the sum of their run times per period. Run times are
+  // measured, a moving average of each task's runs, or as expected when
+  // admitted (see RunEveryMicrosIfFits()) until the task first runs. Tasks
+  // scheduled by other means and the loop's own overhead are not counted:
+  // max_utilization() should leave room for them.
+  uint32_t utilization() const volatile { return this_nv()->utilization_; }
+
+  uint16_t max_utilization() const volatile {
+    return this_nv()->max_utilization_;
+  }
+
+  // Above which the loop counts as overloaded. FULL_UTILIZATION by default.
+  void SetMaxUtilization(uint16_t max_utilization) volatile {
+    this_nv()->max_utilization_ = max_utilization;
+  }
+
+  // Cancels a scheduled callable. May be called from the callable itself
+  // (a periodic one), in which case it is not run again. O(log n).
+  // Returns false if the task has already completed or been canceled.
+  bool Cancel(TaskId task_id) volatile {
     // TODO: thread-safe.
-    this_nv()->tasks_.RemoveSingle(
-      [task_id](const Task& task) { return task.id == task_id; });
-    DLOG(INFO) << "tasks=" << this_nv()->tasks_.size();
+    Scheduler* const this_ = this_nv();
+    Task* const task_ptr = this_->FindTask(task_id);
+    if (!task_ptr) {
+      return false;
+    }
+    Task& task = *task_ptr;
+    const Slot slot = task_id & 0xFF;
+    switch (task.state) {
+      case Task::QUEUED:
+        this_->tasks_.Remove(slot);
+        this_->FreeSlot(slot);
+        break;
+      case Task::READY:
+        this_->RemoveReadyTask(this_->FindReadyTask(slot));
+        this_->FreeSlot(slot);
+        break;
+      case Task::NEW:  // Freed when merged.
+      case Task::NEW_ASYNC:
+      case Task::ASYNC:  // Freed when reached in async_tasks_.
+      case Task::RUNNING:  // Removed and freed when completes.
+        task.state = Task::CANCELED;
+        break;
+      default:  // CANCELED.
+        return false;
+    }
+    DLOG(INFO) << P("tasks=") << this_->tasks_.size();
+    return true;
+  }
+
+  // Sets a budget for each run of a task: the time the task's callable is
+  // expected to complete in. A run that takes longer is reported - logged
+  // and recorded in last_budget_overrun() - and the loop goes on. Returns
+  // false if the task has already completed or been canceled.
+  //
+  // The budget is checked when the callable returns. It can also be checked
+  // while the callable runs, from an interrupt handler, see
+  // CheckRunningTaskBudget().
+  bool SetBudgetMicros(TaskId task_id, uint16_t budget_micros) volatile {
+    Task* const task = this_nv()->FindTask(task_id);
+    if (!task) {
+      return false;
+    }
+    task->budget = ShortTicks::FromMicros(budget_micros);
+    return true;
+  }
+
+  // Sets the priority class of a task. Of the tasks that are due, those of
+  // the highest class are run first. Returns false if the task has already
+  // completed or been canceled. To be called from the main thread.
+  bool SetPriority(TaskId task_id, Priority priority) volatile {
+    Task* const task = this_nv()->FindTask(task_id);
+    if (!task) {
+      return false;
+    }
+    task->priority = priority;
+    return true;
+  }
+
+  // Sets a deadline of a task, relative to the task's scheduled time. Of the
+  // tasks that are due, in the same priority class, the task with the earliest
+  // deadline is run first (EDF). A task without a deadline is run in order of
+  // its scheduled time, as if its deadline was NO_DEADLINE. Returns false if
+  // the task has already completed or been canceled. To be called from the
+  // main thread.
+  bool SetDeadlineMicros(TaskId task_id, uint16_t deadline_micros) volatile {
+    Task* const task = this_nv()->FindTask(task_id);
+    if (!task) {
+      return false;
+    }
+    task->deadline = ShortTicks::FromMicros(deadline_micros);
+    return true;
+  }
+
+  struct BudgetOverrun {
+    TaskId task_id = NO_TASK;
+    DescriptionT* description = nullptr;
+    uint32_t run_time_micros = 0;  // So far, if recorded while running.
+  };
+
+  uint16_t num_budget_overruns() const volatile {
+    return this_nv()->num_budget_overruns_;
+  }
+
+  BudgetOverrun last_budget_overrun() const volatile {
+    BudgetOverrun overrun;
+    ConcurrencyT::Atomically([&]() {
+      overrun = this_nv()->last_budget_overrun_;
+    });
+    return overrun;
+  }
+
+  // Records the running task as over budget, if it has run longer than its
+  // budget. To be called periodically from an interrupt handler, eg. of
+  // a timer or the watchdog (see os/task_budget_watchdog.h), to catch a task
+  // that overruns its budget but does not return, eg. is stuck in a loop.
+  void CheckRunningTaskBudget() volatile {
+    static_assert(ConcurrencyT::FROM_INTERRUPTS,
+                  "Called from an interrupt handler.");
+    Scheduler* const this_ = this_nv();
+    const Slot slot = this_->running_slot_;
+    if (slot == NO_SLOT || this_->running_over_budget_
+        || this_->slots_[slot].budget == ShortTicks()) {
+      return;
+    }
+    const Ticks run_time = timer.Now() - this_->running_start_;
+    if (run_time > this_->slots_[slot].budget) {
+      this_->running_over_budget_ = true;
+      this_->RecordBudgetOverrun(slot, run_time);
+    }
   }
 
   // Runs scheduled callables, including possibly further callables they add,
@@ -104,15 +467,64 @@ public:
   // running - unless it is canceled.
   // Typically, this is the application's main event loop and does not return.
   // See class doc for more information.
+  //
+  // When no task is due, sleeps (see Timer::SleepUntil()) until the earliest
+  // task may be due or until an interrupt, rather than spinning. With
+  // a virtual timer (see os/testing/virtual_timer.h), sleeping jumps straight
+  // to the earliest task's time: a discrete-event simulation.
   void Loop() volatile {
-    while (!this_nv()->tasks_.empty() || !this_nv()->new_tasks_.empty()) {
-      if (!this_nv()->new_tasks_.empty()) {
+    Scheduler* const this_ = this_nv();
+    this_->load_mark_ = timer.Now();
+    this_->stopping_ = false;
+    while ((!this_->tasks_.empty() || this_->num_ready_tasks_
+            || !this_->async_tasks_.empty() || has_new_tasks())
+           && !this_->stopping_) {
+      // Run a due task first, so that a TimingWheelTaskQueue is advanced
+      // to current time before new tasks are inserted.
+      const bool ran_task = RunDueTask();
+      if (has_new_tasks()) {
         MergeNewTasksIntoTasks();
+      } else if (!ran_task && !this_->tasks_.empty()) {
+        Idle();
       }
-      // TODO: Clean up.
-      const_cast<Task&>(this_nv()->tasks_.top())
-        .RunIfTimeAndUpdateTasks(&(this_nv()->tasks_));
     }
+    this_->load_.busy += timer.Now() - this_->load_mark_;
+  }
+
+  // Makes Loop() return once the task being run completes, leaving other
+  // tasks scheduled. A later Loop() call resumes running them. To be called
+  // from a task.
+  void Stop() volatile { this_nv()->stopping_ = true; }
+
+  // Time spent in Loop(): busy - running tasks and scheduling them, and idle
+  // - sleeping until a task is due. Accumulated across Loop() calls until
+  // ResetLoad(). Eg. CPU utilization = busy / (busy + idle).
+  struct Load {
+    uint32_t busy_micros = 0;
+    uint32_t idle_micros = 0;
+  };
+
+  // To be called from a task, or after Loop() returns. Counts time until
+  // the last sleep (inside a task: until before the task).
+  Load load() const volatile {
+    const TickLoad& load = this_nv()->load_;
+    return {load.busy.ToMicros(), load.idle.ToMicros()};
+  }
+
+  void ResetLoad() volatile { this_nv()->load_ = TickLoad(); }
+
+  const StatsT& stats() const volatile { return *this_nv(); }
+
+  // Logs stats (see StatsT::Log()) every given number of microseconds,
+  // then resets them and load(). Requires StatsT::ENABLED.
+  TaskId LogStatsEvery(uint32_t micros) volatile {
+    static_assert(StatsT::ENABLED, "No stats to log.");
+    return RunEveryMicros(micros, [this]() {
+      StatsT* const stats = this_nv();
+      stats->Log(load());
+      stats->Reset();
+      ResetLoad();
+    }, nullptr, Overrun::SKIP);
   }
 
   // Returns a promise resolved after given number of microseconds.
@@ -126,143 +538,657 @@ public:
   // #include "scheduler-promise.h" for definition, after "lib/promise.h"
   // has been included to define Promise<T>. This is to break circular
   // dependency Scheduler -> Promise -> SchedulerExecutor -> Scheduler.
-  Promise<void> AfterMicros(uint32_t micros) volatile;
+  Promise<void> AfterMicros(uint32_t micros,
+                            Priority priority = Priority::NORMAL) volatile;
 
   // Schedules a callable to be run repeatedly every given number
   // of microseconds, starting after one such period, until the callable
   // returns a defined value. Resolves the returned promise with the value.
+  // The callable must return std::optional<T> or, if T is void, bool - the
+  // returned promise is then resolved when the callable returns true.
   //
   // Similar to RunEveryMicrosUntil() but allows to chain dependent actions
   // to the Promise.
   // TODO: Promise::Resolver
-  template <typename T, typename = enable_if_not_void_t<T>>  // SFINAE
+  template <typename T = void, typename F>
   Promise<T> RunEveryMicrosUntilResolved(
-    uint32_t micros, std::function<std::optional<fix_void_t<T>>()>&& callable,
+    uint32_t micros, F&& callable,
     DescriptionT* description = nullptr) volatile {
     PromiseWithResolve<T> promise;
-    RunEveryMicrosUntil(micros, [callable = std::move(callable), promise]() {
-      const std::optional<T> result = callable();
-      if (result) {
-        promise.Resolve(result);
-        return true;
-      } else {
-        return false;
-      }
-    }, description);
+    [[maybe_unused]] const TaskId task_id = RunEveryMicrosUntil(
+      micros, [callable = std::forward<F>(callable), promise]() mutable {
+        if constexpr (!std::is_void_v<T>) {
+          std::optional<T> result = callable();
+          if (result) {
+            promise.Resolve(std::move(*result));
+            return true;
+          } else {
+            return false;
+          }
+        } else {
+          if (callable()) {
+            promise.Resolve();
+            return true;
+          } else {
+            return false;
+          }
+        }
+      }, description);
+    // Nothing else would poll the callable.
+    CHECK(task_id != NO_TASK);
     return promise;
   }
 
-  // Overload of RunEveryMicrosUntilResolved() for bool-returning callables.
-  // The returned promise is resolved when the callable returns true.
-  template <typename T = void, typename = enable_if_is_void_t<T>>  // SFINAE
-  Promise<T> RunEveryMicrosUntilResolved(
-    uint32_t micros, std::function<bool()>&& callable,
-    DescriptionT* description = nullptr) volatile {
-    PromiseWithResolve<T> promise;
-    RunEveryMicrosUntil(micros, [callable = std::move(callable), promise]() mutable {
-      if (callable()) {
-        promise.Resolve();
-        return true;
-      } else {
-        return false;
-      }
-    }, description);
-    return promise;
+  // Returns a promise resolved with the value of given promise or, if it is
+  // not resolved within given number of microseconds, with std::nullopt
+  // (false if T is void, true if resolved in time). Registers the promise's
+  // value handler.
+  //
+  // The timeout is a single task, canceled as soon as the promise is resolved:
+  // an answered wait does not hold a task until its deadline. If that task is
+  // dropped (see NO_TASK), the result is resolved as timed out right away.
+  template <typename T>
+  Promise<std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>>
+  WithTimeout(Promise<T> promise, uint32_t micros) volatile {
+    using ResultT =
+      std::conditional_t<std::is_void_v<T>, bool, std::optional<T>>;
+    PromiseWithResolve<ResultT> result;
+    const TaskId timeout = RunAfterMicros(micros, [result]() mutable {
+      result.Resolve(ResultT());
+    }, P("Resolve() WithTimeout()"));
+    if (timeout == NO_TASK) {
+      result.Resolve(ResultT());
+    }
+    // The timeout has not run if the result is not resolved: its id still
+    // refers to it.
+    if constexpr (!std::is_void_v<T>) {
+      promise.ThenVoid([this, result, timeout](T&& value) mutable {
+        if (!result.is_resolved()) {
+          Cancel(timeout);
+          result.Resolve(ResultT(std::move(value)));
+        }
+      });
+    } else {
+      promise.ThenVoid([this, result, timeout]() mutable {
+        if (!result.is_resolved()) {
+          Cancel(timeout);
+          result.Resolve(true);
+        }
+      });
+    }
+    return result;
+  }
+
+  // Number of tasks run in one pass with another task after waking up from
+  // idle sleep, that is, without a wakeup of their own. See slack_micros
+  // in RunAfterMicros().
+  uint32_t num_coalesced_tasks() const volatile {
+    return this_nv()->num_coalesced_tasks_;
+  }
+
+  // Number of tasks dropped due to no free slot or, for tasks scheduled
+  // by interrupt handlers, a full queue of new tasks. See class doc.
+  uint16_t num_dropped_tasks() const volatile {
+    return this_nv()->num_dropped_tasks_;
   }
 
 protected:
-  TaskId EmplaceNewTask(uint32_t time, uint32_t period,
-                        std::function<void()>&& callable,
-                        DescriptionT* description) volatile {
-    TaskId task_id;
-    size_t num_tasks;
-    CRITICAL_SECTION({
-      // TODO: Separate task_ids for periodic tasks TODO.
-      task_id = next_task_id_++;
-      num_tasks = this_nv()->tasks_.size();
-    });
-    const size_t num_new_tasks = new_tasks_.emplace_back_atomic(
-      task_id, time, period, std::move(callable), description);
-    if (!Thread::is_interrupt()) {
-      DLOG(INFO) << P("tasks=") << num_tasks
-                 << P(" new_tasks=") << num_new_tasks;
+  // Tasks scheduled by the main thread are inserted into tasks_ (async tasks:
+  // appended to async_tasks_) directly. Tasks scheduled by an interrupt
+  // handler are passed via new_tasks_.
+  TaskId EmplaceNewTask(TimePoint time, Ticks period,
+                        Callable&& callable,
+                        DescriptionT* description,
+                        Overrun overrun = Overrun::CATCH_UP,
+                        ShortTicks slack = ShortTicks(),
+                        bool async = false) volatile {
+    Scheduler* const this_ = this_nv();
+    const bool is_interrupt =
+      ConcurrencyT::FROM_INTERRUPTS && Thread::is_interrupt();
+    // Only an interrupt handler adds to new_tasks_, so it does not fill up
+    // between this check and the push below.
+    if (is_interrupt && this_->new_tasks_.size() == MAX_NEW_TASKS) {
+      return DropTask();
+    }
+    const Slot slot = TakeFreeSlot();
+    if (slot == NO_SLOT) {
+      return DropTask();
+    }
+
+    // The slot is not reachable from other threads until added to tasks_
+    // or new_tasks_.
+    Task& task = this_->slots_[slot];
+    task.time = time;
+    task.period = period;
+    task.description = description;
+    task.callable = std::move(callable);
+    task.overrun = overrun;
+    task.slack = slack;
+    if (slack != ShortTicks()) {
+      ConcurrencyT::Atomically([&]() { ++this_nv()->num_slack_tasks_; });
+    }
+    task.budget = ShortTicks();
+    task.priority = Priority::NORMAL;
+    task.deadline = NO_DEADLINE_TICKS;
+    task.shed = 0;
+    task.max_shed = 0;
+    const TaskId task_id = ToTaskId(slot);
+    if (is_interrupt) {
+      task.state = async ? Task::NEW_ASYNC : Task::NEW;
+      this_->new_tasks_.push(slot);
+    } else if (async) {
+      task.state = Task::ASYNC;
+      this_->async_tasks_.push_back(slot);
+    } else {
+      task.state = Task::QUEUED;
+      this_->tasks_.Insert(slot, time);
+      DLOG(INFO) << P("tasks=") << this_->tasks_.size();
     }
     return task_id;
   }
 
-  void MergeNewTasksIntoTasks() volatile {
-    typename NewTaskQueue::iterator new_tasks_begin;
-    typename NewTaskQueue::iterator new_tasks_end;
-    size_t num_tasks;
-    CRITICAL_SECTION({
-      new_tasks_begin = this_nv()->new_tasks_.begin();
-      new_tasks_end = this_nv()->new_tasks_.end();
-      num_tasks = this_nv()->tasks_.size();
+  // Whether interrupt handlers have scheduled tasks, to be merged. Never, and
+  // not checked, with MainThreadScheduling.
+  bool has_new_tasks() const volatile {
+    return ConcurrencyT::FROM_INTERRUPTS && !this_nv()->new_tasks_.empty();
+  }
+
+  TaskId DropTask() volatile {
+    ConcurrencyT::Atomically([&]() {
+      ++this_nv()->num_dropped_tasks_;
     });
+    return NO_TASK;
+  }
 
-    this_nv()->tasks_.move(new_tasks_begin, new_tasks_end);
-    const auto num_tasks_merged =
-      std::distance(new_tasks_begin, new_tasks_end);
-    this_nv()->new_tasks_.pop_front_atomic(num_tasks_merged);
-    DLOG(INFO) << P("tasks=") << num_tasks + num_tasks_merged;
+  // Merges tasks scheduled by interrupt handlers. Lock-free: runs
+  // concurrently with interrupt handlers adding further tasks, which are
+  // then merged on the next call.
+  void MergeNewTasksIntoTasks() volatile {
+    Scheduler* const this_ = this_nv();
+    Slot slot;
+    while (this_->new_tasks_.pop(&slot)) {
+      Task& task = this_->slots_[slot];
+      if (task.state == Task::CANCELED) {
+        this_->FreeSlot(slot);
+      } else if (task.state == Task::NEW_ASYNC) {
+        task.state = Task::ASYNC;
+        this_->async_tasks_.push_back(slot);
+      } else {
+        task.state = Task::QUEUED;
+        this_->tasks_.Insert(slot, task.time);
+      }
+    }
+    DLOG(INFO) << P("tasks=") << this_->tasks_.size();
   }
 
-  struct Task {
-    Task(TaskId id_, uint32_t time_, uint32_t period_,
-         std::function<void()>&& callable_, DescriptionT* description_)
-      : time(time_), period(period_), description(description_),
-        callable(std::move(callable_)), id(id_) { }
-    Task() {} // Needed by FixedCapacityVector.
-
-    void RunIfTimeAndUpdateTasks(TaskQueue* tasks) {
-      if (time <= timer.Now()) {
-        if (!period) {
-          CHECK(this == &tasks->top());
-          std::function<void()> callable_(std::move(callable));
-          tasks->pop();
-          DLOG(INFO) << P("other tasks=") << tasks->size();
-          LogCall();
-          callable_();
-        } else {
-          time += period;  // This temporarily breaks the heap property.
-          // TODO: callable() could possibly add more tasks. 
-          // Is queue.push() / emplace() ok while the heap property is broken?
-          LogCall();
-          callable();
-          tasks->Order();
+  // Runs a single task, if one is due: moves due tasks from tasks_ to ready
+  // tasks, then runs either the first of these (see PickReadyTask()) or the
+  // first async task, per the fairness rules (see class doc). A periodic task
+  // is then rescheduled (see Overrun), unless canceled while running. Returns
+  // whether a task was run.
+  bool RunDueTask() volatile {
+    Scheduler* const this_ = this_nv();
+    Slot slot;
+    const TimePoint now = timer.Now();
+    uint8_t num_due = 0;
+    while (this_->tasks_.PeekDue(now, &slot)) {
+      this_->tasks_.Remove(slot);
+      this_->slots_[slot].state = Task::READY;
+      this_->ready_tasks_[this_->num_ready_tasks_++] = slot;
+      ++num_due;
+    }
+    if (this_->woken_up_) {
+      this_->woken_up_ = false;
+      if (num_due > 1) {
+        this_->num_coalesced_tasks_ += num_due - 1;
+      }
+    }
+    const uint8_t ready =
+      this_->num_ready_tasks_ ? this_->PickReadyTask(now) : NO_READY_TASK;
+    slot = NO_SLOT;
+    if (this_->RunsAsyncTaskFirst(ready, now)) {
+      slot = this_->PopAsyncTask();  // NO_SLOT if all were canceled.
+      ++this_->num_async_tasks_in_a_row_;
+    }
+    if (slot == NO_SLOT) {
+      if (ready == NO_READY_TASK) {
+        return false;
+      }
+      slot = this_->ready_tasks_[ready];
+      this_->RemoveReadyTask(ready);
+      this_->num_async_tasks_in_a_row_ = 0;
+    }
+    DLOG(INFO) << P("other tasks=")
+               << this_->tasks_.size() + this_->num_ready_tasks_
+                  + this_->async_tasks_.size();
+    Task& task = this_->slots_[slot];
+    LogCall(slot);
+    task.state = Task::RUNNING;
+    if (task.budget != ShortTicks()) {
+      ConcurrencyT::Atomically([&]() {  // Read by CheckRunningTaskBudget().
+        this_nv()->running_start_ = now;
+        this_nv()->running_over_budget_ = false;
+      });
+    }
+    this_->running_slot_ = slot;
+    task.callable();  // Run in place: the slot is not reused while running.
+    this_->running_slot_ = NO_SLOT;
+    if (task.budget != ShortTicks()) {
+      CheckBudget(slot, now);
+    }
+    if constexpr (StatsT::ENABLED) {
+      static_cast<StatsT*>(this_)->RecordRun(
+        task.description, (now - task.time).ToMicros(),
+        (timer.Now() - now).ToMicros());
+    }
+    if (task.period != Ticks() && task.state == Task::RUNNING) {
+      this_->RecordRunTime(task, timer.Now() - now);
+      if (task.max_shed) {
+        this_->ShedOrRestore(slot);
+      }
+      task.time = NextRunTime(task);
+      task.state = Task::QUEUED;
+      this_->tasks_.Insert(slot, task.time);
+    } else {
+      this_->FreeSlot(slot);
+    }
+    return true;
+  }
+
+  // Whether to run the first async task rather than the ready task at given
+  // index in ready_tasks_ (NO_READY_TASK if none).
+  bool RunsAsyncTaskFirst(uint8_t ready, TimePoint now) const {
+    if (async_tasks_.empty()) {
+      return false;
+    }
+    if (ready == NO_READY_TASK) {
+      return true;
+    }
+    return EffectivePriority(slots_[ready_tasks_[ready]], now)
+             != Priority::TIME_CRITICAL
+           && num_async_tasks_in_a_row_ < MAX_ASYNC_TASKS_IN_A_ROW;
+  }
+
+  // Removes and returns the first async task's slot that has not been
+  // canceled, freeing the slots of those that have. NO_SLOT if none.
+  Slot PopAsyncTask() {
+    while (!async_tasks_.empty()) {
+      const Slot slot = async_tasks_.front();
+      async_tasks_.pop_front();
+      if (slots_[slot].state != Task::CANCELED) {
+        return slot;
+      }
+      FreeSlot(slot);
+    }
+    return NO_SLOT;
+  }
+
+  // Index in ready_tasks_ of the task to run next: the first of the highest
+  // priority class, then with the earliest deadline, then the earliest
+  // scheduled time. A BACKGROUND task that has waited for too long counts as
+  // NORMAL. O(n) in the number of ready tasks - tasks that are due, typically
+  // a few. Requires num_ready_tasks_ > 0.
+  uint8_t PickReadyTask(TimePoint now) const {
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < num_ready_tasks_; ++i) {
+      if (RunsBefore(slots_[ready_tasks_[i]], slots_[ready_tasks_[best]],
+                     now)) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  static bool RunsBefore(const Task& a, const Task& b, TimePoint now) {
+    const Priority a_priority = EffectivePriority(a, now);
+    const Priority b_priority = EffectivePriority(b, now);
+    if (a_priority != b_priority) {
+      return a_priority < b_priority;
+    }
+    const TimePoint a_deadline = a.time + a.deadline;
+    const TimePoint b_deadline = b.time + b.deadline;
+    if (a_deadline != b_deadline) {
+      return a_deadline < b_deadline;
+    }
+    return a.time < b.time;
+  }
+
+  static Priority EffectivePriority(const Task& task, TimePoint now) {
+    if (task.priority == Priority::BACKGROUND
+        && now - task.time >= MAX_BACKGROUND_WAIT) {
+      return Priority::NORMAL;
+    }
+    return task.priority;
+  }
+
+  // Index in ready_tasks_ of given READY task's slot.
+  uint8_t FindReadyTask(Slot slot) const {
+    uint8_t i = 0;
+    while (ready_tasks_[i] != slot) {
+      ++i;
+    }
+    return i;
+  }
+
+  // Keeps the order of the other ready tasks: among equals, the task that
+  // became due first is run first.
+  void RemoveReadyTask(uint8_t i) {
+    --num_ready_tasks_;
+    for (; i < num_ready_tasks_; ++i) {
+      ready_tasks_[i] = ready_tasks_[i + 1];
+    }
+  }
+
+  // Time of the next run of a periodic task that has just completed.
+  static TimePoint NextRunTime(const Task& task) {
+    const TimePoint next = task.time + task.period;
+    if (task.overrun == Overrun::CATCH_UP) {
+      return next;
+    }
+    const TimePoint now = timer.Now();
+    if (task.overrun == Overrun::DELAY) {
+      return now + task.period;
+    }
+    // SKIP.
+    if (now < next) {
+      return next;
+    }
+    const uint32_t num_missed = (now - next).count() / task.period.count();
+    return next + Ticks((num_missed + 1) * task.period.count());
+  }
+
+  // Of a task run for run_time every period, in 1/FULL_UTILIZATION.
+  // Rounded up. 0 if not periodic.
+  static uint32_t Utilization(ShortTicks run_time, Ticks period) {
+    if (period == Ticks()) {
+      return 0;
+    }
+    const uint32_t busy = uint32_t(run_time.count()) * FULL_UTILIZATION;
+    return busy / period.count() + (busy % period.count() != 0);
+  }
+
+  // Sets a periodic task's run time and period, keeping utilization_ the sum
+  // of the tasks' utilizations. Divides only if either changes.
+  void SetLoad(Task& task, ShortTicks run_time, Ticks period) {
+    if (run_time == task.run_time && period == task.period) {
+      return;
+    }
+    utilization_ -= Utilization(task.run_time, task.period);
+    task.run_time = run_time;
+    task.period = period;
+    utilization_ += Utilization(run_time, period);
+  }
+
+  // Updates the moving average of a periodic task's run time, by 1/8 of the
+  // difference: steady within 8 ticks, the estimate (and utilization_) is
+  // left as is.
+  void RecordRunTime(Task& task, Ticks run_time) {
+    const int32_t measured = run_time.count() > 0xFFFF ? 0xFFFF
+                                                       : run_time.count();
+    const int32_t estimate = task.run_time.count();
+    SetLoad(task, ShortTicks(task.run_time == ShortTicks()
+                               ? measured
+                               : estimate + (measured - estimate) / 8),
+            task.period);
+  }
+
+  // Doubles the period of a sheddable task that has just run, if the loop is
+  // overloaded, or halves it back if the loop is not overloaded with it
+  // halved. See SetSheddable().
+  void ShedOrRestore(Slot slot) {
+    Task& task = slots_[slot];
+    if (utilization_ > max_utilization_) {
+      if (task.shed == task.max_shed) {
+        return;
+      }
+      ++task.shed;
+      SetLoad(task, task.run_time, task.period + task.period);
+    } else {
+      const Ticks half(task.period.count() / 2);
+      if (task.shed == 0
+          || utilization_ - Utilization(task.run_time, task.period)
+             + Utilization(task.run_time, half) > max_utilization_) {
+        return;
+      }
+      --task.shed;
+      SetLoad(task, task.run_time, half);
+    }
+    LogShed(slot);
+  }
+
+  void LogShed(Slot slot) const {
+    const Task& task = slots_[slot];
+    if (task.description) {
+      LOG(INFO) << P("shed task=") << ToTaskId(slot)
+                << P(" description=") << task.description
+                << P(" period=") << task.period.ToMicros()
+                << P(" utilization=") << utilization_;
+    } else {
+      LOG(INFO) << P("shed task=") << ToTaskId(slot)
+                << P(" period=") << task.period.ToMicros()
+                << P(" utilization=") << utilization_;
+    }
+  }
+
+  // Sleeps until the earliest task may be due or, if tasks have slack, until
+  // the earliest task's slack runs out. Does not sleep if a new task has been
+  // added in the meantime (by an interrupt): the check and going to sleep are
+  // atomic. Requires !tasks_.empty() and no ready tasks.
+  void Idle() volatile {
+    Scheduler* const this_ = this_nv();
+    const TimePoint until = this_->num_slack_tasks_
+      ? this_->LatestWakeUpTime() : this_->tasks_.next_time();
+    const TimePoint start = timer.Now();
+    if (until <= start) {
+      return;
+    }
+    TimePoint end = start;
+    if constexpr (ConcurrencyT::FROM_INTERRUPTS) {
+      ConcurrencyT::Atomically([&]() {
+        if (this_nv()->new_tasks_.empty()) {
+          end = timer.SleepUntil(until);
         }
+      });
+    } else {
+      end = timer.SleepUntil(until);
+    }
+    this_->load_.busy += start - this_->load_mark_;
+    this_->load_.idle += end - start;
+    this_->load_mark_ = end;
+    this_->woken_up_ = true;
+  }
+
+  // The earliest time by which a task in tasks_ must be run, given its slack.
+  // O(n) in MAX_TASKS.
+  TimePoint LatestWakeUpTime() const {
+    TimePoint until;
+    bool found = false;
+    for (const Task& task : slots_) {
+      if (task.state != Task::QUEUED) {
+        continue;
+      }
+      const TimePoint task_until = TaskQueue::DueTime(task.time) + task.slack;
+      if (!found || task_until < until) {
+        until = task_until;
+        found = true;
       }
     }
+    return until;
+  }
 
-  private:
-    void LogCall() {
-      if (description) {
-        DLOG(INFO) << P("task=") << id << P(" description=") << description;
-      } else {
-        DLOG(INFO) << P("task=") << id;
+  // Reports a task that has just run, if it has run over its budget.
+  void CheckBudget(Slot slot, TimePoint start) volatile {
+    Scheduler* const this_ = this_nv();
+    const Task& task = this_->slots_[slot];
+    const Ticks run_time = timer.Now() - start;
+    bool recorded_while_running;
+    ConcurrencyT::Atomically([&]() {
+      recorded_while_running = this_nv()->running_over_budget_;
+      if (recorded_while_running) {  // Update to the final run time.
+        this_nv()->last_budget_overrun_.run_time_micros = run_time.ToMicros();
+      }
+    });
+    if (!recorded_while_running) {
+      if (run_time <= task.budget) {
+        return;
       }
+      ConcurrencyT::Atomically([&]() {
+        this_nv()->RecordBudgetOverrun(slot, run_time);
+      });
+    }
+    if (task.description) {
+      LOG(INFO) << P("over budget task=") << ToTaskId(slot)
+                << P(" description=") << task.description
+                << P(" run_time=") << run_time.ToMicros();
+    } else {
+      LOG(INFO) << P("over budget task=") << ToTaskId(slot)
+                << P(" run_time=") << run_time.ToMicros();
+    }
+  }
+
+  // Called with interrupts disabled or from an interrupt handler.
+  void RecordBudgetOverrun(Slot slot, Ticks run_time) volatile {
+    Scheduler* const this_ = this_nv();
+    ++this_->num_budget_overruns_;
+    this_->last_budget_overrun_ = {
+      ToTaskId(slot), this_->slots_[slot].description, run_time.ToMicros()};
+  }
+
+  // Returns nullptr if the task has already completed or been canceled
+  // (task_id is stale).
+  Task* FindTask(TaskId task_id) {
+    const Slot slot = task_id & 0xFF;
+    if (slot >= MAX_TASKS) {
+      return nullptr;
     }
-    
-  public:  // TODO: private.
-    uint32_t time;
-    // TODO: All remainining members const?
-    uint32_t period;
-    DescriptionT* description;
-    std::function<void()> callable;
-    TaskId id;
-  } __attribute__((packed));
+    Task& task = slots_[slot];
+    if (task.generation != (task_id >> 8) || task.state == Task::FREE) {
+      return nullptr;
+    }
+    return &task;
+  }
+
+  // Cancels the task being run. To be called from its callable only.
+  void CancelRunningTask() volatile {
+    Scheduler* const this_ = this_nv();
+    CHECK(this_->running_slot_ != NO_SLOT);
+    this_->slots_[this_->running_slot_].state = Task::CANCELED;
+  }
+
+  // Returns NO_SLOT if there is no free slot.
+  Slot TakeFreeSlot() volatile {
+    Slot slot = NO_SLOT;
+    ConcurrencyT::Atomically([&]() {
+      if (this_nv()->num_free_slots_ > 0) {
+        slot = this_nv()->free_slots_[--this_nv()->num_free_slots_];
+      }
+    });
+    return slot;
+  }
+
+  // Destroys the task's callable and returns its slot to the free slots.
+  // Invalidates the task's TaskId.
+  void FreeSlot(Slot slot) {
+    Task& task = slots_[slot];
+    SetLoad(task, ShortTicks(), task.period);
+    task.callable.reset();
+    task.state = Task::FREE;
+    ++task.generation;
+    ConcurrencyT::Atomically([&]() {
+      if (task.slack != ShortTicks()) {
+        --num_slack_tasks_;
+      }
+      free_slots_[num_free_slots_++] = slot;
+    });
+  }
 
-  struct TaskGreater {
-    constexpr bool operator()(const Task& a, const Task& b) const {
-      return a.time > b.time;
+  TaskId ToTaskId(Slot slot) const volatile {
+    return (TaskId(this_nv()->slots_[slot].generation) << 8) | slot;
+  }
+
+  void LogCall(Slot slot) const volatile {
+    const Task& task = this_nv()->slots_[slot];
+    if (task.description) {
+      DLOG(INFO) << P("task=") << ToTaskId(slot)
+                 << P(" description=") << task.description;
+    } else {
+      DLOG(INFO) << P("task=") << ToTaskId(slot);
     }
+  }
+
+  struct Task {
+    enum State : uint8_t {
+      FREE,      // In free_slots_.
+      NEW,        // In new_tasks_ (scheduled by an interrupt handler).
+      NEW_ASYNC,  // In new_tasks_, to be appended to async_tasks_.
+      QUEUED,     // In tasks_.
+      READY,      // In ready_tasks_: due, waiting to be run.
+      ASYNC,      // In async_tasks_ (see RunAsync()).
+      RUNNING,    // Being run by RunDueTask().
+      CANCELED,   // NEW, ASYNC or RUNNING, to be freed instead of run/queued.
+    };
+
+    TimePoint time;
+    Ticks period;  // Not periodic if 0.
+    DescriptionT* description = nullptr;
+    Callable callable;
+    Overrun overrun = Overrun::CATCH_UP;
+    ShortTicks slack;
+    ShortTicks budget;  // None if 0.
+    ShortTicks deadline = NO_DEADLINE_TICKS;  // Relative to time.
+    // Periodic: estimated run time, see RecordRunTime(). None if 0.
+    ShortTicks run_time;
+    Priority priority = Priority::NORMAL;
+    uint8_t shed = 0;  // Period stretched by 2^shed, see ShedOrRestore().
+    uint8_t max_shed = 0;  // Sheddable if > 0.
+    uint8_t generation = 0;
+    State state = FREE;
   };
 
   // Non-volatile. Members accessed via this_nv
   // are sure to be accessed by this thread only.
   Scheduler* this_nv() const volatile { return const_cast<Scheduler*>(this); }
 
+  std::array<Task, MAX_TASKS> slots_;
+  std::array<Slot, MAX_TASKS> free_slots_;  // Stack.
+  uint8_t num_free_slots_ = MAX_TASKS;
+
   TaskQueue tasks_;
   NewTaskQueue new_tasks_;
-  uint32_t next_task_id_ = 0;
+  // Slots of tasks that are due, in the order they became due.
+  std::array<Slot, MAX_TASKS> ready_tasks_;
+  uint8_t num_ready_tasks_ = 0;
+  static constexpr uint8_t NO_READY_TASK = 0xFF;
+  // Slots of async tasks, in the order they were scheduled. Never full: holds
+  // at most all the slots.
+  CircularBuffer<Slot, MAX_TASKS> async_tasks_;
+  // Run since a task of ready_tasks_ was last run.
+  uint8_t num_async_tasks_in_a_row_ = 0;
+
+  uint16_t num_dropped_tasks_ = 0;
+
+  // Slot of the task being run by RunDueTask(), if any.
+  Slot running_slot_ = NO_SLOT;
+  // Of the task being run, if it has a budget.
+  TimePoint running_start_;
+  bool running_over_budget_ = false;  // Recorded by CheckRunningTaskBudget().
+
+  uint16_t num_budget_overruns_ = 0;
+  BudgetOverrun last_budget_overrun_;
+
+  struct TickLoad {
+    Ticks busy;
+    Ticks idle;
+  } load_;
+  TimePoint load_mark_;  // Time until which load_ is accounted.
+
+  bool stopping_ = false;  // See Stop().
+
+  uint8_t num_slack_tasks_ = 0;  // Tasks with slack, in any state.
+  bool woken_up_ = false;  // From idle sleep, since the last RunDueTask().
+  uint32_t num_coalesced_tasks_ = 0;
+
+  // Sum of Utilization() of tasks. See utilization().
+  uint32_t utilization_ = 0;
+  uint16_t max_utilization_ = FULL_UTILIZATION;
 };
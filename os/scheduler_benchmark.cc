@@ -0,0 +1,267 @@
+// Measures the cost of scheduling operations, and compares Scheduler backends
+// (see os/task_queue.h) at different numbers of outstanding tasks, and
+// interrupt safety policies (see os/scheduler_concurrency.h).
+//
+// Machine-readable output: BENCHMARK_FORMAT=json (see Benchmark).
+
+#include <cstdint>
+#include <cstdio>
+
+#include "os/ticks.h"
+
+
+#define TEST_CRITICAL_SECTION(code) code
+
+
+// Advances 1 usec per Now() call, so that simulated time is independent of
+// host speed and each backend runs the same task schedule.
+class FakeTimer {
+public:
+  TimePoint Now() { return TimePoint(now_++); }
+
+  TimePoint SleepUntil(TimePoint time) {
+    if (TimePoint(now_) < time) {
+      now_ = time.ticks();
+    }
+    return TimePoint(now_);
+  }
+
+private:
+  uint32_t now_ = 0;
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
+
+#include "lib/testing/benchmark.h"
+#include "os/scheduler.h"
+
+
+// Up to 64 outstanding tasks, plus the one being run.
+constexpr size_t MAX_TASKS = 64 + 1;
+
+template <template <size_t> class TaskQueueT,
+          typename ConcurrencyT = InterruptSafeScheduling>
+class TestScheduler : public Scheduler<const char, TaskQueueT, MAX_TASKS,
+                                       NoSchedulerStats, ConcurrencyT> {
+public:
+  using TestScheduler::Scheduler::MAX_NEW_TASKS;
+  using TestScheduler::Scheduler::MergeNewTasksIntoTasks;
+};
+
+// Global Scheduler, for SchedulerExecutor::RunAsync().
+volatile TestScheduler<HeapTaskQueue> scheduler_;
+#define TEST_SCHEDULER scheduler_  // Inject scheduler_ into code under test.
+#include "os/scheduler-global.h"
+#include "os/scheduler_executor.h"
+
+
+// Rounds of num_tasks RunAfterMicros() calls, into an empty scheduler.
+template <template <size_t> class TaskQueueT>
+void BenchmarkInsert(const char* backend, uint8_t num_tasks) {
+  constexpr uint32_t NUM_ROUNDS = 5000;
+  using SchedulerT = TestScheduler<TaskQueueT>;
+  using TaskId = typename SchedulerT::TaskId;
+  volatile SchedulerT scheduler;
+  TaskId tasks[MAX_TASKS];
+  char name[64];
+  std::snprintf(name, sizeof(name), "insert/%s/%u", backend, num_tasks);
+  Benchmark::Run(name, NUM_ROUNDS * num_tasks, [&]() {
+    for (uint32_t round = 0; round < NUM_ROUNDS; ++round) {
+      for (uint8_t i = 0; i < num_tasks; ++i) {
+        tasks[i] = scheduler.RunAfterMicros(1000 + 7 * i, []() {});
+      }
+      Benchmark::Untimed untimed;
+      for (uint8_t i = 0; i < num_tasks; ++i) {
+        scheduler.Cancel(tasks[i]);
+      }
+    }
+  });
+}
+
+
+// Rounds of canceling num_tasks outstanding tasks, in scheduling order.
+template <template <size_t> class TaskQueueT>
+void BenchmarkCancel(const char* backend, uint8_t num_tasks) {
+  constexpr uint32_t NUM_ROUNDS = 5000;
+  using SchedulerT = TestScheduler<TaskQueueT>;
+  using TaskId = typename SchedulerT::TaskId;
+  volatile SchedulerT scheduler;
+  TaskId tasks[MAX_TASKS];
+  char name[64];
+  std::snprintf(name, sizeof(name), "cancel/%s/%u", backend, num_tasks);
+  Benchmark::Run(name, NUM_ROUNDS * num_tasks, [&]() {
+    for (uint32_t round = 0; round < NUM_ROUNDS; ++round) {
+      {
+        Benchmark::Untimed untimed;
+        for (uint8_t i = 0; i < num_tasks; ++i) {
+          tasks[i] = scheduler.RunAfterMicros(1000 + 7 * i, []() {});
+        }
+      }
+      for (uint8_t i = 0; i < num_tasks; ++i) {
+        scheduler.Cancel(tasks[i]);
+      }
+    }
+  });
+}
+
+
+// Rounds of a burst of tasks scheduled by an interrupt handler, filling up
+// the queue of new tasks, merged into num_tasks outstanding tasks.
+template <template <size_t> class TaskQueueT>
+void BenchmarkMergeBurst(const char* backend, uint8_t num_tasks) {
+  constexpr uint32_t NUM_ROUNDS = 20000;
+  using SchedulerT = TestScheduler<TaskQueueT>;
+  using TaskId = typename SchedulerT::TaskId;
+  constexpr uint8_t BURST = SchedulerT::MAX_NEW_TASKS;
+  volatile SchedulerT scheduler;
+  for (uint8_t i = 0; i < num_tasks - BURST; ++i) {
+    scheduler.RunAfterMicros(100000000 + i, []() {});
+  }
+  TaskId burst[BURST];
+  char name[64];
+  std::snprintf(name, sizeof(name), "merge_burst/%s/%u", backend, num_tasks);
+  Benchmark::Run(name, NUM_ROUNDS * BURST, [&]() {
+    for (uint32_t round = 0; round < NUM_ROUNDS; ++round) {
+      {
+        Benchmark::Untimed untimed;
+        Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+        for (uint8_t i = 0; i < BURST; ++i) {
+          burst[i] = scheduler.RunAfterMicros(1000 + 7 * i, []() {});
+        }
+      }
+      scheduler.MergeNewTasksIntoTasks();
+      Benchmark::Untimed untimed;
+      for (uint8_t i = 0; i < BURST; ++i) {
+        scheduler.Cancel(burst[i]);
+      }
+    }
+  });
+}
+
+
+// A chain of RunAsync() calls, each from the callable run by the previous
+// one: the latency from RunAsync() to the callable being run, while
+// num_tasks - 1 other tasks are outstanding.
+void BenchmarkRunAsync(uint8_t num_tasks) {
+  constexpr uint32_t NUM_RUNS = 100000;
+  using TaskId = decltype(scheduler_)::TaskId;
+  TaskId other_tasks[MAX_TASKS];
+  for (uint8_t i = 0; i < num_tasks - 1; ++i) {
+    other_tasks[i] = scheduler_.RunAfterMicros(100000000 + i, []() {});
+  }
+  volatile SchedulerExecutor executor;
+  struct Chain {
+    void operator()() {
+      if (++*runs < NUM_RUNS) {
+        executor->RunAsync(Chain(*this));
+      } else {
+        scheduler_.Stop();
+      }
+    }
+    volatile SchedulerExecutor* executor;
+    uint32_t* runs;
+  };
+  uint32_t runs = 0;
+  executor.RunAsync(Chain{&executor, &runs});
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "run_async/heap/%u", num_tasks);
+  Benchmark::Run(name, NUM_RUNS, []() { scheduler_.Loop(); });
+  for (uint8_t i = 0; i < num_tasks - 1; ++i) {
+    scheduler_.Cancel(other_tasks[i]);
+  }
+}
+
+
+// num_tasks periodic tasks, with different periods, each run num_runs times.
+template <template <size_t> class TaskQueueT,
+          typename ConcurrencyT = InterruptSafeScheduling>
+void BenchmarkPeriodic(const char* backend, uint8_t num_tasks) {
+  constexpr uint32_t RUNS_PER_TASK = 2000;
+  volatile TestScheduler<TaskQueueT, ConcurrencyT> scheduler;
+  for (uint8_t i = 0; i < num_tasks; ++i) {
+    scheduler.RunEveryMicrosUntil(100 + 7 * i, [runs = 0u]() mutable {
+      return ++runs == RUNS_PER_TASK;
+    });
+  }
+  char name[64];
+  std::snprintf(name, sizeof(name), "periodic/%s/%u", backend, num_tasks);
+  Benchmark::Run(name, num_tasks * RUNS_PER_TASK, [&]() { scheduler.Loop(); });
+}
+
+
+// A chain of one-shot tasks, each scheduling the next one, and canceling
+// a far-future task and scheduling a replacement, while num_tasks - 2 other
+// tasks are outstanding.
+template <template <size_t> class TaskQueueT,
+          typename ConcurrencyT = InterruptSafeScheduling>
+void BenchmarkOneShot(const char* backend, uint8_t num_tasks) {
+  constexpr uint32_t NUM_RUNS = 100000;
+  using SchedulerT = TestScheduler<TaskQueueT, ConcurrencyT>;
+  using TaskId = typename SchedulerT::TaskId;
+  volatile SchedulerT scheduler;
+  struct State {
+    uint32_t runs = 0;
+    TaskId far_task;
+    TaskId other_tasks[MAX_TASKS];
+    uint8_t num_other_tasks = 0;
+  } state;
+  for (uint8_t i = 0; i < num_tasks - 2; ++i) {
+    state.other_tasks[state.num_other_tasks++] =
+      scheduler.RunAfterMicros(100000000 + i, []() {});
+  }
+  struct Chain {
+    void operator()() {
+      scheduler->Cancel(state->far_task);
+      if (++state->runs < NUM_RUNS) {
+        state->far_task = scheduler->RunAfterMicros(1000, []() {});
+        scheduler->RunAfterMicros(10, Chain(*this));
+      } else {
+        // Ends the benchmark: Loop() returns once no tasks are left.
+        for (uint8_t i = 0; i < state->num_other_tasks; ++i) {
+          scheduler->Cancel(state->other_tasks[i]);
+        }
+      }
+    }
+    volatile SchedulerT* scheduler;
+    State* state;
+  };
+  state.far_task = scheduler.RunAfterMicros(1000, []() {});
+  scheduler.RunAfterMicros(10, Chain{&scheduler, &state});
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "one_shot/%s/%u", backend, num_tasks);
+  Benchmark::Run(name, NUM_RUNS, [&]() { scheduler.Loop(); });
+}
+
+
+int main() {
+  for (uint8_t num_tasks : {8, 24, 64}) {
+    BenchmarkInsert<HeapTaskQueue>("heap", num_tasks);
+    BenchmarkInsert<TimingWheelTaskQueue>("timing_wheel", num_tasks);
+  }
+  for (uint8_t num_tasks : {8, 24, 64}) {
+    BenchmarkCancel<HeapTaskQueue>("heap", num_tasks);
+    BenchmarkCancel<TimingWheelTaskQueue>("timing_wheel", num_tasks);
+  }
+  for (uint8_t num_tasks : {8, 24, 64}) {
+    BenchmarkMergeBurst<HeapTaskQueue>("heap", num_tasks);
+    BenchmarkMergeBurst<TimingWheelTaskQueue>("timing_wheel", num_tasks);
+  }
+  for (uint8_t num_tasks : {1, 24, 64}) {
+    BenchmarkRunAsync(num_tasks);
+  }
+  for (uint8_t num_tasks : {8, 24, 64}) {
+    BenchmarkPeriodic<HeapTaskQueue>("heap", num_tasks);
+    BenchmarkPeriodic<TimingWheelTaskQueue>("timing_wheel", num_tasks);
+    BenchmarkPeriodic<HeapTaskQueue, MainThreadScheduling>(
+      "heap_main_thread", num_tasks);
+  }
+  for (uint8_t num_tasks : {8, 24, 64}) {
+    BenchmarkOneShot<HeapTaskQueue>("heap", num_tasks);
+    BenchmarkOneShot<TimingWheelTaskQueue>("timing_wheel", num_tasks);
+    BenchmarkOneShot<HeapTaskQueue, MainThreadScheduling>(
+      "heap_main_thread", num_tasks);
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "arduino-ext/critical_section.h"
+
+
+// Scheduler's interrupt safety. Selected via Scheduler's ConcurrencyT template
+// parameter: InterruptSafeScheduling (default) or MainThreadScheduling.
+//
+// Scheduler accepts tasks from interrupt handlers, via its lock-free queue of
+// new tasks, only if ConcurrencyT::FROM_INTERRUPTS, and runs code that shares
+// state with interrupt handlers as:
+//
+//   // Runs f() atomically with respect to interrupt handlers.
+//   template <typename F> static void Atomically(F&& f);
+
+
+// Tasks may be scheduled, and budgets checked (see
+// Scheduler::CheckRunningTaskBudget()), from interrupt handlers. Shared state
+// is accessed with interrupts disabled, for a few instructions at a time.
+struct InterruptSafeScheduling {
+  static constexpr bool FROM_INTERRUPTS = true;
+
+  template <typename F>
+  static void Atomically(F&& f) {
+    CRITICAL_SECTION({
+      f();
+    });
+  }
+};
+
+
+// Tasks are scheduled from the main thread only - from other tasks or before
+// Loop() - never from interrupt handlers. Interrupts are never disabled and
+// the queue of new tasks is never checked: critical sections compile away.
+// For applications whose interrupt handlers only set state polled by tasks.
+//
+// Scheduler goes to idle sleep without disabling interrupts: no task can
+// arrive from an interrupt handler between the check and the sleep.
+struct MainThreadScheduling {
+  static constexpr bool FROM_INTERRUPTS = false;
+
+  template <typename F>
+  static void Atomically(F&& f) {
+    f();
+  }
+};
@@ -1,19 +1,40 @@
 
 #pragma once
 
+#include <type_traits>
+#include <utility>
+
 #include "lib/closures.h"
 #include "os/executor.h"
 #include "os/scheduler.h"
+#include "os/thread.h"
 
 
 // Executor implementation that delegates to a global Scheduler.
 // Note: Scheduler.Loop() must be called for it to finally run the callables.
+//
+// The callable bound with its args is stored inline in a scheduler task
+// (see Scheduler::Callable) - RunAsync() does not allocate memory. Callables
+// are run in the order they were passed to RunAsync() (see
+// Scheduler::RunAsync()).
+//
+// If the scheduler drops the task (no free slot, see Scheduler::NO_TASK),
+// the callable is run right away when passed from the main thread, rather
+// than never: eg. a promise's value handler still runs. Passed from
+// an interrupt handler, it is dropped (see Scheduler::num_dropped_tasks()).
 class SchedulerExecutor : public Executor {
 public:
   template <typename F, typename... Args>
   void RunAsync(F&& callable, Args&&... args) volatile {
-    auto callable_args = Closures::Bind(
-      std::forward<F>(callable), std::forward<Args>(args)...);
-    scheduler.RunAfterMicros(0, std::move(callable_args), P("RunAsync()"));
+    using SchedulerT = std::remove_cv_t<std::remove_reference_t<
+      decltype(scheduler)>>;
+    // Not moved from if the task is dropped.
+    typename SchedulerT::Callable callable_args(Closures::Bind(
+      std::forward<F>(callable), std::forward<Args>(args)...));
+    if (scheduler.RunAsync(std::move(callable_args), P("RunAsync()"))
+          == SchedulerT::NO_TASK
+        && !Thread::is_interrupt()) {
+      callable_args();
+    }
   }
 };
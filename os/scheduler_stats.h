@@ -0,0 +1,128 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "lib/histogram.h"
+#include "lib/log.h"
+
+
+// Scheduler instrumentation. Selected via Scheduler's StatsT template
+// parameter: NoSchedulerStats (default) or SchedulerStats.
+//
+// Scheduler measures a task's run only if StatsT::ENABLED, and then calls:
+//
+//   // After a task has run. lateness: from the task's time until it started.
+//   void RecordRun(DescriptionT* description,
+//                  uint32_t lateness, uint32_t run_time);
+//   // Logs recorded stats and the scheduler's busy / idle time.
+//   template <typename LoadT> void Log(const LoadT& load) const;
+//   void Reset();
+
+
+// No instrumentation. Empty: as Scheduler's base class, takes no space, and
+// Scheduler does not measure tasks, so no time is spent either.
+struct NoSchedulerStats {
+  static constexpr bool ENABLED = false;
+};
+
+
+// Per task description histograms of task lateness and run time, in usec.
+// Tasks with the same description - the same description pointer - are
+// recorded together, eg. all runs of a periodic task. Tasks without
+// a description are recorded together too.
+//
+// Records up to max_descriptions different descriptions. Runs of tasks with
+// further descriptions are only counted.
+template <typename DescriptionT,
+          uint8_t max_descriptions = 8, uint8_t num_buckets = 12>
+class SchedulerStats {
+public:
+  static constexpr bool ENABLED = true;
+
+  using Histogram = ::Histogram<num_buckets>;
+
+  struct TaskStats {
+    DescriptionT* description;
+    Histogram lateness;
+    Histogram run_time;
+  };
+
+  void RecordRun(DescriptionT* description,
+                 uint32_t lateness, uint32_t run_time) {
+    TaskStats* task_stats = Find(description);
+    if (!task_stats) {
+      if (num_task_stats_ == max_descriptions) {
+        ++num_unrecorded_runs_;
+        return;
+      }
+      task_stats = &task_stats_[num_task_stats_++];
+      task_stats->description = description;
+    }
+    task_stats->lateness.Add(lateness);
+    task_stats->run_time.Add(run_time);
+  }
+
+  // Returns nullptr if no task with given description has been recorded.
+  const TaskStats* Find(DescriptionT* description) const {
+    for (uint8_t i = 0; i < num_task_stats_; ++i) {
+      if (task_stats_[i].description == description) {
+        return &task_stats_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  TaskStats* Find(DescriptionT* description) {
+    return const_cast<TaskStats*>(
+      static_cast<const SchedulerStats*>(this)->Find(description));
+  }
+
+  uint16_t num_unrecorded_runs() const { return num_unrecorded_runs_; }
+
+  // Logs one message with load and one per description, with the counts of
+  // histogram buckets as consecutive values.
+  template <typename LoadT>
+  void Log(const LoadT& load) const {
+    LOG(INFO) << P("busy_micros=") << load.busy_micros
+              << P(" idle_micros=") << load.idle_micros
+              << P(" unrecorded_runs=") << num_unrecorded_runs_;
+    for (uint8_t i = 0; i < num_task_stats_; ++i) {
+      LogTaskStats(task_stats_[i], std::make_index_sequence<num_buckets>());
+    }
+  }
+
+  void Reset() {
+    num_task_stats_ = 0;
+    num_unrecorded_runs_ = 0;
+    for (TaskStats& task_stats : task_stats_) {
+      task_stats.lateness.Reset();
+      task_stats.run_time.Reset();
+    }
+  }
+
+private:
+  template <size_t... buckets>
+  static void LogTaskStats(const TaskStats& task_stats,
+                           std::index_sequence<buckets...>) {
+    if (task_stats.description) {
+      ((LOG(INFO) << P("description=") << task_stats.description
+                  << P(" lateness=")) << ...
+                  << task_stats.lateness.count(buckets));
+      ((LOG(INFO) << P("description=") << task_stats.description
+                  << P(" run_time=")) << ...
+                  << task_stats.run_time.count(buckets));
+    } else {
+      ((LOG(INFO) << P("lateness=")) << ...
+                  << task_stats.lateness.count(buckets));
+      ((LOG(INFO) << P("run_time=")) << ...
+                  << task_stats.run_time.count(buckets));
+    }
+  }
+
+  std::array<TaskStats, max_descriptions> task_stats_;
+  uint8_t num_task_stats_ = 0;
+  uint16_t num_unrecorded_runs_ = 0;
+};
@@ -0,0 +1,97 @@
+// Schedules tasks from a simulated interrupt handler - a thread - while
+// the scheduler's loop runs in the main thread.
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "os/ticks.h"
+
+using namespace std;
+
+
+// Simulates disabling interrupts: excludes the simulated interrupt handler.
+mutex interrupts;
+#define TEST_CRITICAL_SECTION(code) {                 \
+    lock_guard<mutex> interrupts_disabled(interrupts);  \
+    code                                              \
+  }
+
+
+// Real time, shared by the threads.
+class SteadyTimer {
+public:
+  TimePoint Now() {
+    return TimePoint(chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start_).count());
+  }
+
+  // Returns right away, as though woken up by an interrupt.
+  TimePoint SleepUntil(TimePoint /*time*/) { return Now(); }
+
+private:
+  const chrono::steady_clock::time_point start_ = chrono::steady_clock::now();
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
+
+#include "os/scheduler.h"
+
+using SchedulerT = Scheduler<const char>;
+
+
+int main() {
+  constexpr uint32_t NUM_INTERRUPTS = 5000;
+  volatile SchedulerT scheduler;
+  atomic<uint32_t> num_scheduled(0);
+  atomic<uint32_t> num_dropped(0);
+  atomic<bool> interrupts_done(false);
+  uint32_t num_run = 0;
+
+  // Main thread tasks, competing with the interrupt handler for slots.
+  uint32_t num_main_run = 0;
+  const SchedulerT::TaskId competing = scheduler.RunEveryMicros(15, [&]() {
+    const SchedulerT::TaskId task_id =
+      scheduler.RunAfterMicros(30, [&num_main_run]() { ++num_main_run; });
+    if (task_id != SchedulerT::NO_TASK && task_id % 2) {
+      scheduler.Cancel(task_id);
+    }
+  });
+  // Ends the loop once all tasks scheduled by the interrupt handler have run.
+  scheduler.RunEveryMicrosUntil(20, [&]() {
+    if (interrupts_done && num_run == num_scheduled) {
+      scheduler.Cancel(competing);
+      return true;
+    }
+    return false;
+  });
+
+  thread interrupt_handler([&]() {
+    Thread::Indicator interrupt(Thread::Id::INTERRUPT);
+    for (uint32_t i = 0; i < NUM_INTERRUPTS; ++i) {
+      const SchedulerT::TaskId task_id = scheduler.RunAfterMicros(
+        i % 50, [&num_run]() { ++num_run; });
+      if (task_id == SchedulerT::NO_TASK) {
+        ++num_dropped;
+      } else {
+        ++num_scheduled;
+      }
+      if (i % 4 == 0) {
+        this_thread::yield();
+      }
+    }
+    interrupts_done = true;
+  });
+  scheduler.Loop();
+  interrupt_handler.join();
+
+  assert(num_scheduled > 0);
+  assert(num_scheduled + num_dropped == NUM_INTERRUPTS);
+  assert(scheduler.num_dropped_tasks() >= num_dropped);  // + main thread's.
+  assert(num_run == num_scheduled);
+  assert(num_main_run > 0);
+  return 0;
+}
@@ -1,17 +1,31 @@
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
+#include "os/ticks.h"
 
-#define TEST_CRITICAL_SECTION(code) code  // TODO
+
+// Counts critical sections entered by code under test. TODO: Disable
+// simulated interrupts.
+int num_critical_sections = 0;
+#define TEST_CRITICAL_SECTION(code) { ++num_critical_sections; code }
 
 
 class FakeTimer {
 public:
-  uint32_t Now() {
-    return now_++;
+  TimePoint Now() {
+    return TimePoint(now_++);
   };
 
-  void Reset() { now_ = 0; }
+  void Reset(uint32_t now = 0) { now_ = now; }
+
+  TimePoint SleepUntil(TimePoint time) {
+    if (TimePoint(now_) < time) {
+      now_ = time.ticks();
+    }
+    return TimePoint(now_);
+  }
 
 private:                                 
   uint32_t now_ = 0;
@@ -19,23 +33,47 @@ private:
 
 #define TEST_TIMER timer_  // Inject Fake timer into code under test.
 
+#include "lib/testing/allocation_counter.h"
 #include "os/scheduler.h"
 
 using TaskId = Scheduler<const char>::TaskId;
+using Callable = Scheduler<const char>::Callable;
 
+// Forwards to the Scheduler instance under test, of any backend.
 class SchedulerProxy {
 public:
-  TaskId RunAfterMicros(uint32_t micros, std::function<void()>&& f,
+  using Callable = ::Callable;
+  static constexpr TaskId NO_TASK = Scheduler<const char>::NO_TASK;
+
+  TaskId RunAfterMicros(uint32_t micros, Callable&& f,
                         const char* description = nullptr) volatile {
-    return scheduler_->RunAfterMicros(micros, std::move(f), description);
+    return run_after_micros_(scheduler_, micros, std::move(f), description);
   }
 
-  void Set(volatile Scheduler<const char>* scheduler) {
+  TaskId RunAsync(Callable&& f, const char* description = nullptr) volatile {
+    return run_async_(scheduler_, std::move(f), description);
+  }
+
+  template <typename SchedulerT>
+  void Set(volatile SchedulerT* scheduler) {
     scheduler_ = scheduler;
+    run_after_micros_ = [](volatile void* scheduler, uint32_t micros,
+                           Callable&& f, const char* description) {
+      return static_cast<volatile SchedulerT*>(scheduler)->RunAfterMicros(
+        micros, std::move(f), description);
+    };
+    run_async_ = [](volatile void* scheduler, Callable&& f,
+                    const char* description) {
+      return static_cast<volatile SchedulerT*>(scheduler)->RunAsync(
+        std::move(f), description);
+    };
   }
 
 private:
-  volatile Scheduler<const char>* scheduler_ = nullptr;
+  volatile void* scheduler_ = nullptr;
+  TaskId (*run_after_micros_)(
+    volatile void*, uint32_t, Callable&&, const char*) = nullptr;
+  TaskId (*run_async_)(volatile void*, Callable&&, const char*) = nullptr;
 } scheduler_;
 
 #define TEST_SCHEDULER scheduler_  // Inject scheduler_ into code under test.
@@ -49,7 +87,7 @@ public:
   uint32_t time() const { return time_.value(); }
 
   void Make() {
-    time_ = timer_.Now();
+    time_ = timer_.Now().ticks();
   }
 
 private:
@@ -57,14 +95,22 @@ private:
 };
 
   
+// Extra lateness allowed by the scheduler backend under test. The fake timer
+// advances on every Now() call, so lateness is counted in scheduler steps.
+uint32_t tolerance = 0;
+
+template <size_t capacity>
+using OneTimerTickWheel = TimingWheelTaskQueue<capacity, MICROS_PER_TICK>;
+
 void AssertInRange(uint32_t t, uint32_t a, uint32_t b) {
-  assert(a <= t && t < b);
+  assert(a <= t && t < b + tolerance);
 }
 
 
-int main() {
+template <typename SchedulerT>
+void TestScheduler() {
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -80,10 +126,67 @@ int main() {
     AssertInRange(calls[4].time(), 400, 405);
   }
 
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Idle: the loop sleeps until the next task is due, instead of spinning.
+    Call calls[5];
+    scheduler.RunAfterMicros(1000, [&calls]() { calls[1].Make(); });
+    scheduler.RunAfterMicros(3000, [&calls]() { calls[2].Make(); });
+    scheduler.Loop();
+
+    AssertInRange(calls[1].time(), 1000, 1005);
+    AssertInRange(calls[2].time(), 3000, 3005);
+    const auto load = scheduler.load();
+    assert(load.idle_micros >= 3000 - 2 * (50 + tolerance));
+    assert(load.busy_micros <= 2 * (50 + tolerance));
+    scheduler.ResetLoad();
+    assert(scheduler.load().idle_micros == 0);
+  }
+
+  using Overrun = typename SchedulerT::Overrun;
+  for (Overrun overrun : {Overrun::CATCH_UP, Overrun::SKIP, Overrun::DELAY}) {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // A periodic task overruns: its first run takes 2.5 periods.
+    Call calls[4];
+    scheduler.RunEveryMicrosUntil(100, [&calls, i = 0]() mutable {
+      calls[i].Make();
+      if (i == 0) {
+        timer_.SleepUntil(TimePoint(calls[0].time() + 250));
+      }
+      return ++i == 4;
+    }, nullptr, overrun);
+    scheduler.Loop();
+
+    AssertInRange(calls[0].time(), 100, 105);
+    switch (overrun) {
+      case Overrun::CATCH_UP:  // Runs due at 200 and 300 back to back.
+        AssertInRange(calls[1].time(), 350, 360);
+        AssertInRange(calls[2].time(), calls[1].time(), 370);
+        AssertInRange(calls[3].time(), 400, 405);
+        break;
+      case Overrun::SKIP:  // Skips runs due at 200 and 300.
+        AssertInRange(calls[1].time(), 400, 405);
+        AssertInRange(calls[2].time(), 500, 505);
+        AssertInRange(calls[3].time(), 600, 605);
+        break;
+      case Overrun::DELAY:  // Runs 100 after the first run completes at 350.
+        AssertInRange(calls[1].time(), 450, 460);
+        AssertInRange(calls[2].time(), calls[1].time() + 100,
+                      calls[1].time() + 110);
+        break;
+    }
+  }
+
   // TODO: Test scheduling a new task from inside a task, while scheduler is running.
 
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -100,7 +203,7 @@ int main() {
   }
 
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -126,7 +229,7 @@ int main() {
   }
 
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -151,7 +254,225 @@ int main() {
   }
 
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // A TaskId of a completed task is stale: it does not cancel a new task
+    // reusing the task's slot.
+    Call calls[5];
+    const TaskId completed =
+      scheduler.RunAfterMicros(100, [&calls]() { calls[0].Make(); });
+    scheduler.Loop();
+    TaskId reused = scheduler.RunAfterMicros(
+      100, [&calls]() { calls[1].Make(); });
+    assert((reused & 0xFF) == (completed & 0xFF));  // Same slot.
+    assert(!scheduler.Cancel(completed));
+    scheduler.Loop();
+    assert(calls[1]);
+
+    // So is a TaskId of a canceled task.
+    const TaskId canceled =
+      scheduler.RunAfterMicros(100, [&calls]() { calls[2].Make(); });
+    assert(scheduler.Cancel(canceled));
+    assert(!scheduler.Cancel(canceled));
+    reused = scheduler.RunAfterMicros(100, [&calls]() { calls[3].Make(); });
+    scheduler.Loop();
+    assert(!scheduler.Cancel(canceled));
+    assert(!calls[2]);
+    assert(calls[3]);
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Tasks that become due while a task runs are run by priority class,
+    // then earliest deadline.
+    using Priority = typename SchedulerT::Priority;
+    Call calls[6];
+    scheduler.RunAfterMicros(50, []() { timer_.SleepUntil(TimePoint(200)); });
+    const TaskId background =
+      scheduler.RunAfterMicros(100, [&calls]() { calls[5].Make(); });
+    scheduler.SetPriority(background, Priority::BACKGROUND);
+    const TaskId later_deadline =
+      scheduler.RunAfterMicros(110, [&calls]() { calls[4].Make(); });
+    scheduler.SetDeadlineMicros(later_deadline, 100);  // At 210.
+    const TaskId earlier_deadline =
+      scheduler.RunAfterMicros(120, [&calls]() { calls[3].Make(); });
+    scheduler.SetDeadlineMicros(earlier_deadline, 20);  // At 140.
+    scheduler.RunAfterMicros(130, [&calls]() { calls[0].Make(); });
+    const TaskId time_critical =
+      scheduler.RunAfterMicros(140, [&calls]() { calls[1].Make(); });
+    scheduler.SetPriority(time_critical, Priority::TIME_CRITICAL);
+    const TaskId canceled =
+      scheduler.RunAfterMicros(150, [&calls]() { calls[2].Make(); });
+    scheduler.SetPriority(canceled, Priority::BACKGROUND);
+    const TaskId canceling =
+      scheduler.RunAfterMicros(160, [&]() { scheduler.Cancel(canceled); });
+    scheduler.SetPriority(canceling, Priority::TIME_CRITICAL);
+    scheduler.Loop();
+
+    assert(!calls[2]);  // Canceled while due.
+    assert(200 <= calls[1].time());
+    assert(calls[1].time() < calls[3].time());  // Time-critical first.
+    assert(calls[3].time() < calls[4].time());  // Deadline at 140 < 210.
+    assert(calls[4].time() < calls[0].time());  // Deadline < no deadline.
+    assert(calls[0].time() < calls[5].time());  // Background last.
+    assert(!scheduler.SetPriority(background, Priority::NORMAL));  // Stale.
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // A background task is not starved by a backlog of normal tasks.
+    using Priority = typename SchedulerT::Priority;
+    Call background_call;
+    const TaskId background =
+      scheduler.RunAfterMicros(150, [&]() { background_call.Make(); });
+    scheduler.SetPriority(background, Priority::BACKGROUND);
+    scheduler.RunEveryMicrosUntil(100, [&]() {
+      timer_.SleepUntil(timer_.Now() + Ticks(200));  // Always overruns.
+      return bool(background_call);
+    });
+    scheduler.Loop();
+
+    AssertInRange(background_call.time(),
+                  150 + SchedulerT::MAX_BACKGROUND_WAIT_MICROS,
+                  150 + SchedulerT::MAX_BACKGROUND_WAIT_MICROS + 250);
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Tasks with slack are coalesced: run together, after one wakeup, once
+    // the earliest task's slack runs out.
+    Call calls[5];
+    scheduler.RunAfterMicros(100, [&calls]() { calls[0].Make(); }, nullptr, 50);
+    scheduler.RunAfterMicros(120, [&calls]() { calls[1].Make(); });
+    scheduler.RunAfterMicros(130, [&calls]() { calls[2].Make(); }, nullptr, 20);
+    scheduler.RunAfterMicros(200, [&calls]() { calls[3].Make(); }, nullptr, 100);
+    scheduler.RunAfterMicros(400, [&calls]() { calls[4].Make(); });
+    scheduler.Loop();
+
+    AssertInRange(calls[0].time(), 120, 130);  // Late, but within slack.
+    AssertInRange(calls[1].time(), 120, 130);
+    AssertInRange(calls[2].time(), 150, 160);  // On its own: no slack left.
+    AssertInRange(calls[3].time(), 300, 310);
+    AssertInRange(calls[4].time(), 400, 410);
+    assert(scheduler.num_coalesced_tasks() == 1);
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // A task over its budget is reported, and the loop goes on.
+    Call calls[5];
+    const char* const slow = "slow";
+    const TaskId within_budget = scheduler.RunAfterMicros(100, [&calls]() {
+      calls[0].Make();
+      timer_.SleepUntil(TimePoint(calls[0].time() + 40));
+    });
+    assert(scheduler.SetBudgetMicros(within_budget, 50));
+    const TaskId over_budget = scheduler.RunAfterMicros(200, [&calls]() {
+      calls[1].Make();
+      timer_.SleepUntil(TimePoint(calls[1].time() + 100));
+    }, slow);
+    assert(scheduler.SetBudgetMicros(over_budget, 50));
+    scheduler.RunAfterMicros(400, [&calls]() { calls[2].Make(); });
+    scheduler.Loop();
+
+    assert(calls[0] && calls[1] && calls[2]);
+    assert(scheduler.num_budget_overruns() == 1);
+    auto overrun = scheduler.last_budget_overrun();
+    assert(overrun.task_id == over_budget);
+    assert(overrun.description == slow);
+    assert(overrun.run_time_micros >= 100);
+    assert(!scheduler.SetBudgetMicros(over_budget, 50));  // Stale.
+
+    // Checked from an interrupt handler while the task runs: recorded before
+    // the task returns, once.
+    TaskId stuck;
+    stuck = scheduler.RunAfterMicros(100, [&]() {
+      calls[3].Make();
+      timer_.SleepUntil(TimePoint(calls[3].time() + 30));
+      {
+        Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+        scheduler.CheckRunningTaskBudget();  // Within budget.
+      }
+      assert(scheduler.num_budget_overruns() == 1);
+      timer_.SleepUntil(TimePoint(calls[3].time() + 100));
+      {
+        Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+        scheduler.CheckRunningTaskBudget();
+      }
+      assert(scheduler.num_budget_overruns() == 2);
+      assert(scheduler.last_budget_overrun().task_id == stuck);
+      timer_.SleepUntil(TimePoint(calls[3].time() + 200));
+    });
+    scheduler.SetBudgetMicros(stuck, 50);
+    scheduler.Loop();
+
+    assert(scheduler.num_budget_overruns() == 2);
+    overrun = scheduler.last_budget_overrun();
+    assert(overrun.task_id == stuck);
+    assert(overrun.description == nullptr);
+    assert(overrun.run_time_micros >= 200);  // Final.
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Async tasks are run in the order they were scheduled, including those
+    // scheduled by async tasks, after the ones already waiting. One scheduled
+    // by an interrupt handler joins them when merged, after the first task.
+    std::vector<int> order;
+    scheduler.RunAsync([&]() {
+      order.push_back(0);
+      scheduler.RunAsync([&]() { order.push_back(3); });
+    });
+    scheduler.RunAsync([&]() { order.push_back(1); });
+    const TaskId canceled = scheduler.RunAsync([&]() { order.push_back(-1); });
+    scheduler.RunAsync([&]() { order.push_back(2); });
+    {
+      Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+      scheduler.RunAsync([&]() { order.push_back(4); });
+    }
+    assert(scheduler.Cancel(canceled));
+    assert(!scheduler.Cancel(canceled));
+    scheduler.Loop();
+    assert(order == std::vector<int>({0, 1, 2, 3, 4}));
+
+    // Fairness towards due tasks: a time-critical task first, then at most
+    // MAX_ASYNC_TASKS_IN_A_ROW async tasks before another due task.
+    using Priority = typename SchedulerT::Priority;
+    order.clear();
+    scheduler.RunAfterMicros(10, [&]() {
+      timer_.SleepUntil(TimePoint(100));
+      for (int i = 0; i < 6; ++i) {
+        scheduler.RunAsync([&order, i]() { order.push_back(i); });
+      }
+    });
+    scheduler.RunAfterMicros(50, [&]() { order.push_back(10); });
+    const TaskId time_critical =
+      scheduler.RunAfterMicros(60, [&]() { order.push_back(20); });
+    scheduler.SetPriority(time_critical, Priority::TIME_CRITICAL);
+    scheduler.Loop();
+    static_assert(SchedulerT::MAX_ASYNC_TASKS_IN_A_ROW == 4);
+    assert(order == std::vector<int>({20, 0, 1, 2, 3, 10, 4, 5}));
+  }
+
+  {
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -166,9 +487,87 @@ int main() {
     AssertInRange(calls[3].time(), 300, 310);
     AssertInRange(calls[4].time(), 400, 410);
   }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    Call calls[2];
+    std::optional<int> value;
+    scheduler.WithTimeout(scheduler.AfterMicros(100).Then([]() { return 1; }),
+                          1000)
+      .ThenVoid([&calls, &value](std::optional<int>&& v) {
+        value = v;
+        calls[0].Make();
+      });
+    PromiseWithResolve<void> never;
+    bool in_time = true;
+    scheduler.WithTimeout(Promise<void>(never), 300)
+      .ThenVoid([&calls, &in_time](bool resolved) {
+        in_time = resolved;
+        calls[1].Make();
+      });
+    scheduler.Loop();
+
+    assert(value == 1);
+    AssertInRange(calls[0].time(), 100, 110);
+    assert(!in_time);
+    AssertInRange(calls[1].time(), 300, 310);
+    // The first timeout was canceled once resolved: the loop ended before it.
+    assert(timer_.Now().ticks() < 1000);
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // If the scheduler is full, AfterMicros() is resolved right away and
+    // a promise's value handler is run right away, rather than never.
+    std::vector<TaskId> tasks;
+    TaskId task;
+    while ((task = scheduler.RunAfterMicros(1000, []() {}))
+           != SchedulerT::NO_TASK) {
+      tasks.push_back(task);
+    }
+    Promise<void> slept = scheduler.AfterMicros(100);
+    assert(slept.is_resolved());
+    bool handled = false;
+    slept.ThenVoid([&handled]() { handled = true; });
+    assert(handled);
+    for (TaskId task : tasks) {
+      scheduler.Cancel(task);
+    }
+  }
+
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Timed out right away if the scheduler is full.
+    std::vector<TaskId> tasks;
+    TaskId task;
+    while ((task = scheduler.RunAfterMicros(1000, []() {}))
+           != SchedulerT::NO_TASK) {
+      tasks.push_back(task);
+    }
+    PromiseWithResolve<void> never;
+    Promise<bool> in_time = scheduler.WithTimeout(Promise<void>(never), 300);
+    assert(in_time.is_resolved());
+    for (TaskId task : tasks) {
+      scheduler.Cancel(task);
+    }
+    bool resolved = true;
+    in_time.ThenVoid([&resolved](bool r) { resolved = r; });
+    scheduler.Loop();
+    assert(!resolved);
+    assert(timer_.Now().ticks() < 300);
+  }
   
   {
-    volatile Scheduler scheduler;
+    volatile SchedulerT scheduler;
     scheduler_.Set(&scheduler);
     timer_.Reset();
 
@@ -191,5 +590,250 @@ int main() {
     AssertInRange(calls[0].time(), 300, 310);
   }
 
+  {
+    volatile SchedulerT scheduler;
+    scheduler_.Set(&scheduler);
+    timer_.Reset();
+
+    // Steady state: tasks scheduling further tasks, periodic tasks, RunAsync().
+    // Callables are stored inline in tasks, so no allocations.
+    AllocationCounter allocations;
+    int num_calls = 0;
+    int num_periodic_calls = 0;
+    struct Chain {
+      void operator()() {
+        ++*num_calls;
+        if (*num_calls < 10) {
+          scheduler->RunAfterMicros(10, Chain(*this));
+          executor.RunAsync([](int* i) { ++*i; }, num_calls_async);
+        }
+      }
+      volatile SchedulerT* scheduler;
+      int* num_calls;
+      int* num_calls_async;
+    };
+    int num_calls_async = 0;
+    scheduler.RunAfterMicros(
+      10, Chain{&scheduler, &num_calls, &num_calls_async});
+    const TaskId periodic = scheduler.RunEveryMicros(
+      7, [&num_periodic_calls]() { ++num_periodic_calls; });
+    scheduler.RunAfterMicros(150, [&]() { scheduler.Cancel(periodic); });
+    scheduler.Loop();
+
+    assert(num_calls == 10);
+    assert(num_calls_async == 9);
+    assert(num_periodic_calls == 21);
+    assert(allocations.count() == 0);
+  }
+}
+
+
+// Runs across the wraparound of the timer: times compare wrap-safe.
+template <typename SchedulerT>
+void TestWraparound() {
+  static_assert(TimePoint(0xFFFFFFF0) < TimePoint(0x10));
+  static_assert(TimePoint(0x10) - TimePoint(0xFFFFFFF0) == Ticks(0x20));
+
+  volatile SchedulerT scheduler;
+  scheduler_.Set(&scheduler);
+  timer_.Reset(0xFFFFFFFF - 150);
+
+  // Due before, around and after the wraparound, periodic across it.
+  std::vector<int> order;
+  for (int i : {3, 1, 2}) {
+    scheduler.RunAfterMicros(i * 100, [&order, i]() { order.push_back(i); });
+  }
+  int num_periodic_calls = 0;
+  scheduler.RunEveryMicrosUntil(40, [&num_periodic_calls]() {
+    return ++num_periodic_calls == 8;
+  });
+  scheduler.Loop();
+
+  assert(order == std::vector<int>({1, 2, 3}));
+  assert(num_periodic_calls == 8);
+  assert(timer_.Now() < TimePoint(300));  // Did not wait for the next wrap.
+}
+
+
+// Periodic tasks are admitted, and shed, by their measured run times.
+void TestAdmissionControl() {
+  using SchedulerT = Scheduler<const char>;
+  volatile SchedulerT scheduler;
+  scheduler_.Set(&scheduler);
+  timer_.Reset();
+  scheduler.SetMaxUtilization(SchedulerT::FULL_UTILIZATION / 2);
+  const auto run_for = [&scheduler](uint32_t micros) {
+    scheduler.RunAfterMicros(micros, [&scheduler]() { scheduler.Stop(); });
+    scheduler.Loop();
+  };
+
+  {
+    // Measured: 30% of the loop, one task.
+    uint32_t run_time = 300;
+    const TaskId measured = scheduler.RunEveryMicros(1000, [&run_time]() {
+      timer_.SleepUntil(timer_.Now() + Ticks(run_time));
+    });
+    assert(scheduler.utilization() == 0);  // Not run yet.
+    run_for(2500);
+    AssertInRange(scheduler.utilization(), 308, 312);
+
+    // Does not fit. Fits every 2000 usec, if allowed.
+    assert(scheduler.RunEveryMicrosIfFits(1000, 300, []() {})
+           == SchedulerT::NO_TASK);
+    assert(scheduler.RunEveryMicrosIfFits(1000, 300, []() {}, nullptr, 1999)
+           == SchedulerT::NO_TASK);
+    const uint32_t utilization = scheduler.utilization();
+    std::vector<uint32_t> runs;
+    const TaskId degraded = scheduler.RunEveryMicrosIfFits(
+      1000, 300, [&runs]() { runs.push_back(timer_.Now().ticks()); },
+      nullptr, 4000);
+    assert(degraded != SchedulerT::NO_TASK);
+    assert(scheduler.utilization() == utilization + 154);
+    run_for(4100);
+    assert(runs.size() == 2);
+    AssertInRange(runs[1] - runs[0], 2000, 2001);
+
+    // Completed and canceled tasks no longer count.
+    scheduler.Cancel(degraded);
+    AssertInRange(scheduler.utilization(), 308, 312);
+    scheduler.Cancel(measured);
+    assert(scheduler.utilization() == 0);
+  }
+
+  {
+    // A sheddable task is stretched while another task runs longer, up to
+    // its max period, then restored.
+    uint32_t run_time = 200;
+    const TaskId other = scheduler.RunEveryMicros(1000, [&run_time]() {
+      timer_.SleepUntil(timer_.Now() + Ticks(run_time));
+    });
+    std::vector<uint32_t> runs;
+    const TaskId sheddable = scheduler.RunEveryMicros(1000, [&runs]() {
+      runs.push_back(timer_.Now().ticks());
+      timer_.SleepUntil(timer_.Now() + Ticks(100));
+    });
+    assert(scheduler.SetSheddable(sheddable, 8000));
+    run_for(10000);
+    assert(runs.size() == 10);  // Not overloaded.
+
+    run_time = 600;
+    runs.clear();
+    run_for(50000);
+    const auto max_interval = [&runs]() {
+      uint32_t max = 0;
+      for (size_t i = 1; i < runs.size(); ++i) {
+        max = std::max(max, runs[i] - runs[i - 1]);
+      }
+      return max;
+    };
+    AssertInRange(max_interval(), 8000, 8800);
+    AssertInRange(runs.back() - runs[runs.size() - 2], 8000, 8800);
+
+    run_time = 200;
+    runs.clear();
+    run_for(50000);
+    AssertInRange(runs.back() - runs[runs.size() - 2], 1000, 1100);
+    scheduler.Cancel(other);
+    scheduler.Cancel(sheddable);
+  }
+}
+
+
+// Without tasks from interrupt handlers: runs as the default scheduler does,
+// and never disables interrupts.
+void TestMainThreadScheduling() {
+  using SchedulerT = Scheduler<const char, HeapTaskQueue, 24,
+                               NoSchedulerStats, MainThreadScheduling>;
+  volatile SchedulerT scheduler;
+  scheduler_.Set(&scheduler);
+  timer_.Reset();
+  num_critical_sections = 0;
+
+  std::vector<int> order;
+  const TaskId canceled =
+    scheduler.RunAfterMicros(150, [&order]() { order.push_back(0); });
+  scheduler.RunAfterMicros(200, [&order]() { order.push_back(3); });
+  scheduler.RunAfterMicros(100, [&]() {
+    order.push_back(1);
+    scheduler.RunAsync([&order]() { order.push_back(2); });
+    assert(scheduler.Cancel(canceled));
+  });
+  const TaskId over_budget = scheduler.RunAfterMicros(300, []() {
+    timer_.SleepUntil(timer_.Now() + Ticks(100));
+  });
+  scheduler.SetBudgetMicros(over_budget, 10);
+  scheduler.Loop();
+
+  assert(order == std::vector<int>({1, 2, 3}));
+  assert(scheduler.num_budget_overruns() == 1);
+  assert(scheduler.last_budget_overrun().task_id == over_budget);
+  assert(num_critical_sections == 0);
+}
+
+
+void TestSchedulerStats() {
+  using SchedulerT =
+    Scheduler<const char, HeapTaskQueue, 24, SchedulerStats<const char, 2>>;
+  volatile SchedulerT scheduler;
+  scheduler_.Set(&scheduler);
+  timer_.Reset();
+
+  const char* const sensor = "sensor";
+  const char* const slow = "slow";
+  const char* const other = "other";
+  scheduler.RunEveryMicrosUntil(100, [i = 0]() mutable {
+    return ++i == 3;
+  }, sensor);
+  scheduler.RunAfterMicros(250, []() {
+    timer_.SleepUntil(timer_.Now() + Ticks(1000));  // Runs for 1000 usec.
+  }, slow);
+  scheduler.RunAfterMicros(260, []() {}, other);  // Third description.
+  scheduler.Loop();
+
+  const auto* sensor_stats = scheduler.stats().Find(sensor);
+  assert(sensor_stats);
+  // Runs at 100 and 200 on time, at 300 after the slow task: late.
+  assert(sensor_stats->lateness.count(0) + sensor_stats->lateness.count(1)
+         == 2);
+  assert(sensor_stats->lateness.count(
+           decltype(sensor_stats->lateness)::Bucket(1250 - 300)) == 1);
+  const auto* slow_stats = scheduler.stats().Find(slow);
+  assert(slow_stats);
+  assert(slow_stats->run_time.count(
+           decltype(slow_stats->run_time)::Bucket(1000)) == 1);
+  assert(!scheduler.stats().Find(other));  // Over max_descriptions.
+  assert(scheduler.stats().num_unrecorded_runs() == 1);
+
+  // Logged and reset periodically.
+  const TaskId log_stats = scheduler.LogStatsEvery(100);
+  scheduler.RunAfterMicros(150, [&]() {
+    assert(!scheduler.stats().Find(sensor));
+    assert(scheduler.stats().num_unrecorded_runs() == 0);
+    scheduler.Cancel(log_stats);
+  });
+  scheduler.Loop();
+}
+
+
+int main() {
+  static_assert(std::is_empty_v<NoSchedulerStats>);
+  TestSchedulerStats();
+
+  TestScheduler<Scheduler<const char>>();
+
+  // Timing wheel rounds task time up to timer ticks (4 usec), and pops
+  // tasks due in the same tick one per loop iteration.
+  tolerance = 8;
+  TestScheduler<Scheduler<const char, TimingWheelTaskQueue>>();
+
+  TestWraparound<Scheduler<const char>>();
+  // Wrap-safe if the wheel's ticks are the timer's ticks.
+  TestWraparound<Scheduler<const char, OneTimerTickWheel>>();
+
+  TestAdmissionControl();
+  TestMainThreadScheduling();
+  TestWraparound<Scheduler<const char, HeapTaskQueue, 24, NoSchedulerStats,
+                           MainThreadScheduling>>();
+
   return 0;
 }
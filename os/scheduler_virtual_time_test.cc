@@ -0,0 +1,53 @@
+// Runs the scheduler in virtual time: a long scenario completes in
+// milliseconds of host time, with exact timing of events.
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+#include "os/testing/virtual_timer.h"
+#include "os/testing/test_scheduler.h"
+
+
+int main() {
+  {
+    // A 3-minute match: a control tick every 10 msec, a sensor read every
+    // 50 msec taking 2 msec, telemetry every second.
+    using Priority = TestScheduler::Priority;
+    constexpr uint32_t MATCH_MICROS = 3 * 60 * 1000000;
+    uint32_t num_control_ticks = 0;
+    uint32_t num_late_control_ticks = 0;
+    vector<uint32_t> telemetry_times;
+    const auto control = scheduler_.RunEveryMicros(10000, [&]() {
+      if (timer_.Now().ticks() != ++num_control_ticks * 10000) {
+        ++num_late_control_ticks;
+      }
+    });
+    scheduler_.SetPriority(control, Priority::TIME_CRITICAL);
+    scheduler_.RunEveryMicros(50000, []() { timer_.Advance(2000); });
+    const auto telemetry = scheduler_.RunEveryMicros(1000000, [&]() {
+      telemetry_times.push_back(timer_.Now().ticks());
+    });
+    scheduler_.SetPriority(telemetry, Priority::BACKGROUND);
+    // Until just before the control tick following the match.
+    scheduler_.Loop(MATCH_MICROS + 9999);
+
+    assert(timer_.Now().ticks() == MATCH_MICROS + 9999);
+    assert(num_control_ticks == MATCH_MICROS / 10000);
+    // Time-critical: run first when due together with a sensor read.
+    assert(num_late_control_ticks == 0);
+    // Background: run last, after a sensor read due at the same time.
+    assert(telemetry_times.size() == 180);
+    assert(telemetry_times[0] == 1000000 + 2000);
+    assert(telemetry_times[179] == MATCH_MICROS + 2000);
+
+    // Busy only while reading sensors.
+    const auto load = scheduler_.load();
+    assert(load.busy_micros == MATCH_MICROS / 50000 * 2000);
+    assert(load.idle_micros == MATCH_MICROS + 9999 - load.busy_micros);
+  }
+
+  return 0;
+}
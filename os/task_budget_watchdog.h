@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include <avr/interrupt.h>  // TODO: Wrap in arduino-core/*, os/arduino.h.
+#include <avr/wdt.h>
+
+#include "arduino-ext/critical_section.h"
+#include "os/scheduler-global.h"
+#include "os/thread.h"
+
+
+// Enforces task budgets (see Scheduler::SetBudgetMicros()) while tasks run:
+// the watchdog timer, in interrupt mode, periodically checks if the task being
+// run is over budget. Catches tasks that do not return in time, or at all.
+// The watchdog does not reset the MCU.
+//
+// Resolution is the watchdog period, ~16 msec: a task is caught up to that
+// late. Tasks are also checked when they return, exactly.
+class TaskBudgetWatchdog {
+public:
+  static void Start() {
+    CRITICAL_SECTION({
+      wdt_reset();
+      // WDRF, set by a watchdog reset, forces WDE on: cleared first, or the
+      // watchdog would stay in reset mode.
+      MCUSR &= ~_BV(WDRF);
+      // Timed sequence: change enable, then interrupt mode, 16 msec period.
+      WDTCSR = _BV(WDCE) | _BV(WDE);
+      WDTCSR = _BV(WDIE);
+    });
+  }
+
+  static void Stop() {
+    wdt_disable();
+  }
+};
+
+
+ISR(WDT_vect) {
+  Thread::Indicator interrupt_thread(Thread::Id::INTERRUPT);
+  scheduler.CheckRunningTaskBudget();
+}
@@ -0,0 +1,121 @@
+
+#pragma once
+
+#include <cstdint>
+
+#include "lib/indexed_heap.h"
+#include "lib/timing_wheel.h"
+#include "os/ticks.h"
+
+
+// Scheduler backends: queues of tasks ordered by time, from which Scheduler
+// pops tasks that are due. Selected via Scheduler's TaskQueueT template
+// parameter.
+//
+// Tasks themselves stay in Scheduler's fixed slab of task slots. A backend
+// only orders slot indices, each inserted with the task's time. Times compare
+// wrap-safe (see os/ticks.h). Each backend implements:
+//
+//   bool empty() const;
+//   size_t size() const;
+//   void Insert(Slot slot, TimePoint time);
+//   void Remove(Slot slot);
+//   // If a task is due at given time (its time <= now), stores its slot
+//   // in *slot and returns true. The task stays in the queue until
+//   // Remove()d: Scheduler moves due tasks to its ready tasks, and Insert()s
+//   // a periodic task again after it runs.
+//   bool PeekDue(TimePoint now, Slot* slot);
+//   // Earliest time at which a task may be due: a lower bound on the task
+//   // times, not necessarily exact. Requires !empty().
+//   TimePoint next_time() const;
+//   // Earliest time at which PeekDue() yields a task of given time.
+//   static TimePoint DueTime(TimePoint time);
+
+
+// Binary heap backend. O(log n) Insert and Remove, O(1) PeekDue. Yields due
+// tasks in time order.
+template <size_t capacity>
+class HeapTaskQueue {
+public:
+  using Slot = uint8_t;
+
+  bool empty() const { return heap_.empty(); }
+  size_t size() const { return heap_.size(); }
+
+  void Insert(Slot slot, TimePoint time) {
+    heap_.Insert(slot, time);
+  }
+
+  void Remove(Slot slot) {
+    heap_.Remove(slot);
+  }
+
+  bool PeekDue(TimePoint now, Slot* slot) {
+    if (heap_.empty() || heap_.key(heap_.top()) > now) {
+      return false;
+    }
+    *slot = heap_.top();
+    return true;
+  }
+
+  TimePoint next_time() const {  // Exact.
+    return heap_.key(heap_.top());
+  }
+
+  static TimePoint DueTime(TimePoint time) { return time; }
+
+private:
+  IndexedHeap<TimePoint, capacity> heap_;
+};
+
+
+// Hierarchical timing wheel backend, keyed on wheel ticks of tick_micros
+// (by default 4 usec - Arduino timer resolution, that is, a timer tick on the
+// board). O(1) Insert and Remove, amortized O(1) PeekDue. Yields due
+// tasks in wheel tick order, in unspecified order within a wheel tick. A task
+// is never due before its time, and is due at most one wheel tick after
+// (rounded up to the next wheel tick).
+//
+// Wrap-safe if a wheel tick is a timer tick. Otherwise wheel ticks wrap around
+// before timer ticks do.
+template <size_t capacity, uint32_t tick_micros = 4>
+class TimingWheelTaskQueue {
+  static constexpr uint32_t TIMER_TICKS_PER_TICK =
+    tick_micros / MICROS_PER_TICK;
+  static_assert(TIMER_TICKS_PER_TICK > 0
+                && tick_micros % MICROS_PER_TICK == 0,
+                "Wheel tick not a multiple of timer tick.");
+
+public:
+  using Slot = uint8_t;
+
+  bool empty() const { return wheel_.empty(); }
+  size_t size() const { return wheel_.size(); }
+
+  void Insert(Slot slot, TimePoint time) {
+    wheel_.Insert(slot, (time.ticks() + TIMER_TICKS_PER_TICK - 1)
+                          / TIMER_TICKS_PER_TICK);
+  }
+
+  void Remove(Slot slot) {
+    wheel_.Remove(slot);
+  }
+
+  bool PeekDue(TimePoint now, Slot* slot) {
+    *slot = wheel_.PeekExpired(now.ticks() / TIMER_TICKS_PER_TICK);
+    return *slot != Wheel::NONE;
+  }
+
+  TimePoint next_time() const {
+    return TimePoint(wheel_.NextTick() * TIMER_TICKS_PER_TICK);
+  }
+
+  static TimePoint DueTime(TimePoint time) {
+    return TimePoint((time.ticks() + TIMER_TICKS_PER_TICK - 1)
+                     / TIMER_TICKS_PER_TICK * TIMER_TICKS_PER_TICK);
+  }
+
+private:
+  using Wheel = TimingWheel<capacity>;
+  Wheel wheel_;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+// Fakes the on-board compare timer (see os/compare_timer.h). Driven by the
+// test: Advance() moves the counter forward tick by tick and, like
+// the hardware, raises the compare-match interrupt - calls given handler -
+// when the counter reaches the armed ticks. To simulate code that runs
+// slower than the counter, set_ticks_per_read() moves the counter forward on
+// each NowTicks().
+class FakeCompareTimer {
+public:
+  static constexpr uint8_t TICKS_PER_MICRO = 2;
+
+  void Start() {
+    now_ = 0;
+    armed_ = false;
+  }
+
+  uint16_t NowTicks() {
+    const uint16_t now = now_;
+    for (uint8_t i = 0; i < ticks_per_read_; ++i) {
+      ++now_;
+      // Raised once interrupts are enabled again, ie. on Advance().
+      pending_ = pending_ || (armed_ && now_ == compare_);
+    }
+    return now;
+  }
+
+  // Like the hardware, clears a match pending from before.
+  void Arm(uint16_t ticks) {
+    compare_ = ticks;
+    armed_ = true;
+    pending_ = false;
+  }
+
+  void Disarm() { armed_ = false; }
+
+  bool armed() const { return armed_; }
+  uint16_t compare_ticks() const { return compare_; }
+
+  void set_ticks_per_read(uint8_t ticks) { ticks_per_read_ = ticks; }
+
+  template <typename F>
+  void Advance(uint32_t ticks, F&& handle_compare_match) {
+    if (pending_ && armed_) {
+      pending_ = false;
+      handle_compare_match();
+    }
+    while (ticks--) {
+      ++now_;
+      if (armed_ && now_ == compare_) {
+        handle_compare_match();
+      }
+    }
+  }
+
+private:
+  uint16_t now_ = 0;
+  uint16_t compare_ = 0;
+  bool armed_ = false;
+  bool pending_ = false;
+  uint8_t ticks_per_read_ = 0;
+} compare_timer_;
+
+#define TEST_COMPARE_TIMER compare_timer_  // Inject into code under test.
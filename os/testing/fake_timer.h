@@ -3,11 +3,13 @@
 
 #include <cstdint>
 
+#include "os/ticks.h"
+
 // Fakes on-board Arduino timer, configured to tick every 4 usec
 // (every 64 clock cycles) in the Arduino IDE code.
 class FakeTimer {
 public:
-  uint32_t Now() {
+  TimePoint Now() {
     // Tick only every 100 calls (~ scheduler operations) so that
     // the scheduler can manage all its operations without racing,
     // allowing exact timing of events in test.
@@ -15,9 +17,18 @@ public:
       call_count_ = 0;
       now_ += 4;
     }
-    return now_;
+    return TimePoint(now_);
   };
 
+  // Sleeps instantly, advancing time to given time (rounded up to a tick).
+  TimePoint SleepUntil(TimePoint time) {
+    while (TimePoint(now_) < time) {
+      now_ += 4;
+    }
+    call_count_ = 0;
+    return TimePoint(now_);
+  }
+
 private:                                 
   uint32_t now_ = 0;
   int call_count_ = 0;
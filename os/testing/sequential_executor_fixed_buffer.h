@@ -8,6 +8,7 @@
 #include "lib/circular_buffer.h"
 #include "lib/closures.h"
 #include "os/executor.h"
+#include "os/ticks.h"
 #include "os/timer-global.h"
 
 
@@ -31,31 +32,32 @@ public:
   }
 
   void RunAfterMicros(uint32_t micros, std::function<void()>&& f) volatile {
-    RunAt(timer.Now() + micros, std::move(f));
+    RunAt(timer.Now() + Ticks::FromMicros(micros), std::move(f));
   }
 
-  void RunEveryMicros(uint32_t period, std::function<void()>&& f) volatile {
+  void RunEveryMicros(uint32_t micros, std::function<void()>&& f) volatile {
+    const Ticks period = Ticks::FromMicros(micros);
     RunPeriodicAt(timer.Now() + period, period, std::move(f));
   }
   
-  void RunAt(uint32_t micros, std::function<void()>&& f) volatile {
-    RunAsync([this, micros, f = std::move(f)]() mutable {
-      if (timer.Now() >= micros) {
+  void RunAt(TimePoint time, std::function<void()>&& f) volatile {
+    RunAsync([this, time, f = std::move(f)]() mutable {
+      if (timer.Now() >= time) {
         f();
       } else {
-        RunAt(micros, std::move(f));
+        RunAt(time, std::move(f));
       }
     }, nullptr);
   }
 
-  void RunPeriodicAt(uint32_t micros, uint32_t period,
+  void RunPeriodicAt(TimePoint time, Ticks period,
                      std::function<void()>&& f) volatile {
-    RunAsync([this, micros, period, f = std::move(f)]() mutable {
-      if (timer.Now() >= micros) {
+    RunAsync([this, time, period, f = std::move(f)]() mutable {
+      if (timer.Now() >= time) {
         f();
-        RunPeriodicAt(micros + period, period, std::move(f));
+        RunPeriodicAt(time + period, period, std::move(f));
       } else {
-        RunPeriodicAt(micros, period, std::move(f));
+        RunPeriodicAt(time, period, std::move(f));
       }
     }, nullptr);
   }
@@ -1,29 +1,19 @@
-
 #pragma once
 
 #include "os/scheduler.h"
 
-// Scheduler variant that can be stopped after given time.
-class TestScheduler : public Scheduler {
+// Scheduler variant that can be stopped after given time. With a virtual timer
+// (see os/testing/virtual_timer.h), runs in virtual time: see Scheduler::Loop().
+class TestScheduler : public Scheduler<const char> {
 public:
-  // Runs at most for given duration.
-  void Loop(uint32_t duration_usec) {
-    Loop();
-    RunAfterMicros(duration_usec, [this]() { Stop(); });
-  }
-
-  void Loop() {
-    while (!tasks_.empty() && !should_stop_) {
-      const_cast<Task&>(tasks_.top()).RunIfTimeAndUpdateTasks(&tasks_);
-    }
-  }
-
-  void Stop() {
-    should_stop_ = true;
+  // Runs for given duration, then returns, leaving remaining tasks scheduled.
+  void Loop(uint32_t duration_usec) volatile {
+    const TaskId stop = RunAfterMicros(duration_usec, [this]() { Stop(); });
+    Scheduler::Loop();
+    Cancel(stop);  // If stopped earlier by a task.
   }
 
-private:
-  bool should_stop_ = false;
+  using Scheduler::Loop;
 } scheduler_;
 
 #define TEST_SCHEDULER scheduler_  // Inject scheduler_ into code under test.
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "os/ticks.h"
+
+// Fakes on-board Arduino timer with virtual time, for discrete-event
+// simulation: time stands still while code runs, unless advanced explicitly,
+// and jumps when Scheduler sleeps until the next task is due. Simulated time
+// is independent of how fast the host runs the code under test: a long
+// scenario completes in milliseconds of host time, with exact, deterministic
+// timing of events.
+class VirtualTimer {
+public:
+  TimePoint Now() const { return now_; }
+
+  // Advances time to given time, if in the future. Returns immediately.
+  TimePoint SleepUntil(TimePoint time) {
+    if (now_ < time) {
+      now_ = time;
+    }
+    return now_;
+  }
+
+  // Advances time by given number of usec, eg. to simulate code under test
+  // taking time to run.
+  void Advance(uint32_t micros) { now_ += Ticks::FromMicros(micros); }
+
+  void Reset() { now_ = TimePoint(); }
+
+private:
+  TimePoint now_;
+} timer_;
+
+#define TEST_TIMER timer_  // Inject timer_ into code under test.
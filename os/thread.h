@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 class Thread {
 public:
   enum class Id : uint8_t {
@@ -8,7 +10,11 @@ public:
     INTERRUPT
   };
 
+#ifdef __AVR__
   static volatile Id id;
+#else  // Development environment: interrupts are simulated by threads.
+  static thread_local Id id;
+#endif
 
   static bool is_interrupt() {
     return id == Id::INTERRUPT;
@@ -26,6 +32,10 @@ public:
   };
 };
 
+#ifdef __AVR__
 inline volatile Thread::Id Thread::id;
+#else
+inline thread_local Thread::Id Thread::id;
+#endif
 
 inline Thread::Indicator main_thread(Thread::Id::MAIN);
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+
+
+// Time of the global Timer in its native unit, ticks, rather than usec: reading
+// the timer involves no conversion. Conversions from and to usec are left to
+// the edges, eg. APIs that take usec, logs read by humans.
+//
+// The timer is 32-bit and wraps around (on the board, every 4.8 hours).
+// TimePoints compare wrap-safe, by their signed difference: correctly across
+// the wraparound, provided that the compared time points are within 2^31 ticks
+// of each other (on the board, 2.4 hours) - eg. times of tasks scheduled at
+// most that far ahead.
+//
+// Analog of C++ chrono duration and time_point, with the tick as the period.
+// Eg.
+//   const TimePoint deadline = timer.Now() + Ticks::FromMicros(500);
+//   ...
+//   if (deadline <= timer.Now()) { ... }
+
+
+// On the board: Timer0 at 16 MHz, prescaler 64. In the development environment,
+// fake and virtual timers (see os/testing/) count in usec.
+#ifdef __AVR__
+constexpr uint32_t MICROS_PER_TICK = 4;
+#else
+constexpr uint32_t MICROS_PER_TICK = 1;
+#endif
+
+
+// Duration in ticks, of RepT range.
+template <typename RepT>
+class Duration {
+public:
+  constexpr Duration() : ticks_(0) {}
+  constexpr explicit Duration(RepT ticks) : ticks_(ticks) {}
+
+  // Rounded up to a whole tick: never shorter than given.
+  static constexpr Duration FromMicros(uint32_t micros) {
+    return Duration((micros + MICROS_PER_TICK - 1) / MICROS_PER_TICK);
+  }
+
+  constexpr uint32_t ToMicros() const {
+    return static_cast<uint32_t>(ticks_) * MICROS_PER_TICK;
+  }
+
+  constexpr RepT count() const { return ticks_; }
+
+  constexpr Duration operator+(Duration other) const {
+    return Duration(ticks_ + other.ticks_);
+  }
+
+  constexpr Duration operator-(Duration other) const {
+    return Duration(ticks_ - other.ticks_);
+  }
+
+  Duration& operator+=(Duration other) {
+    ticks_ += other.ticks_;
+    return *this;
+  }
+
+  // Durations of different ranges compare by their tick counts.
+  template <typename OtherRepT>
+  constexpr bool operator==(Duration<OtherRepT> other) const {
+    return static_cast<uint32_t>(ticks_) == other.count();
+  }
+
+  template <typename OtherRepT>
+  constexpr bool operator!=(Duration<OtherRepT> other) const {
+    return !(*this == other);
+  }
+
+  template <typename OtherRepT>
+  constexpr bool operator<(Duration<OtherRepT> other) const {
+    return static_cast<uint32_t>(ticks_) < other.count();
+  }
+
+  template <typename OtherRepT>
+  constexpr bool operator<=(Duration<OtherRepT> other) const {
+    return !(other < *this);
+  }
+
+  template <typename OtherRepT>
+  constexpr bool operator>(Duration<OtherRepT> other) const {
+    return other < *this;
+  }
+
+  template <typename OtherRepT>
+  constexpr bool operator>=(Duration<OtherRepT> other) const {
+    return !(*this < other);
+  }
+
+private:
+  RepT ticks_;
+};
+
+using Ticks = Duration<uint32_t>;
+
+// Up to 2^16 ticks (on the board, 262 msec), eg. budgets, deadlines. Half the
+// size of Ticks, and cheaper to compute with on an 8-bit MCU.
+using ShortTicks = Duration<uint16_t>;
+
+
+// Point in time of the timer, in ticks since it started, modulo 2^32.
+class TimePoint {
+public:
+  constexpr TimePoint() : ticks_(0) {}
+  constexpr explicit TimePoint(uint32_t ticks) : ticks_(ticks) {}
+
+  constexpr uint32_t ticks() const { return ticks_; }
+
+  // Since the timer started, modulo 2^32 usec, like Arduino micros().
+  constexpr uint32_t ToMicros() const { return ticks_ * MICROS_PER_TICK; }
+
+  template <typename RepT>
+  constexpr TimePoint operator+(Duration<RepT> duration) const {
+    return TimePoint(ticks_ + duration.count());
+  }
+
+  template <typename RepT>
+  constexpr TimePoint operator-(Duration<RepT> duration) const {
+    return TimePoint(ticks_ - duration.count());
+  }
+
+  template <typename RepT>
+  TimePoint& operator+=(Duration<RepT> duration) {
+    ticks_ += duration.count();
+    return *this;
+  }
+
+  // Time elapsed since an earlier time point. Requires !(*this < earlier).
+  constexpr Ticks operator-(TimePoint earlier) const {
+    return Ticks(ticks_ - earlier.ticks_);
+  }
+
+  constexpr bool operator==(TimePoint other) const {
+    return ticks_ == other.ticks_;
+  }
+
+  constexpr bool operator!=(TimePoint other) const {
+    return ticks_ != other.ticks_;
+  }
+
+  // Wrap-safe, see above.
+  constexpr bool operator<(TimePoint other) const {
+    return static_cast<int32_t>(ticks_ - other.ticks_) < 0;
+  }
+
+  constexpr bool operator<=(TimePoint other) const {
+    return !(other < *this);
+  }
+
+  constexpr bool operator>(TimePoint other) const { return other < *this; }
+
+  constexpr bool operator>=(TimePoint other) const {
+    return !(*this < other);
+  }
+
+private:
+  uint32_t ticks_;
+};
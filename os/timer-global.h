@@ -1,8 +1,13 @@
 #pragma once
 
 #ifndef TEST_TIMER
+#ifdef __AVR__
 #include "os/timer.h"
 inline volatile Timer timer;  // Global Timer instance.
+#else  // A Linux process.
+#include "os/linux/epoll_timer.h"
+inline volatile EpollTimer timer;  // Global Timer instance.
+#endif
 #else
 auto& timer = TEST_TIMER;  // Injected global Timer.
 #endif
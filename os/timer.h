@@ -1,14 +1,27 @@
-
 #pragma once
 
 #include "os/arduino.h"
+#include "os/ticks.h"
 
 
-// Monotonic clock. Very rudimentary analog of C++ system_clock.
+// Monotonic clock, in native timer ticks (see os/ticks.h). Very rudimentary
+// analog of C++ steady_clock.
 class Timer {
 public:
-  // TODO: Pass / return C++ duration<T>.
-  uint32_t Now() volatile {
-    return Arduino::GetMicrosecondsSinceStart();
+  TimePoint Now() volatile {
+    return TimePoint(Arduino::GetTicksSinceStart());
+  }
+
+  // Blocks until given time or until an interrupt, whichever is first.
+  // Returns the time after. To be called with interrupts disabled
+  // (see Arduino::SleepUntilInterrupt()).
+  //
+  // Sleeps until any interrupt: the timer's overflow interrupt wakes the MCU
+  // every 1024 usec, so the caller should check the time and call again.
+  TimePoint SleepUntil(TimePoint time) volatile {
+    if (Now() < time) {
+      Arduino::SleepUntilInterrupt();
+    }
+    return Now();
   }
 };